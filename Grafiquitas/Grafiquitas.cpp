@@ -43,6 +43,16 @@
 #include "RePiRasterizerStage.h"
 
 #include "RePiResourceManager.h"
+#include "RePiImageWriter.h"
+#include "RePiTexturePool.h"
+#include "RePiResolutionScaler.h"
+#include "RePiTemporalReprojection.h"
+#include "RePiCheckerboard.h"
+#include "RePiShadingRateImage.h"
+#include "RePiGBuffer.h"
+#include "RePiVisibilityBuffer.h"
+#include "RePiLightGrid.h"
+#include "RePiCascadedShadowMap.h"
 #include "RePi3DModel.h"
 #include "RePiAnimator.h"
 #include "RePiCamera.h"
@@ -75,13 +85,46 @@ std::shared_ptr<RasterizerConstantBuffer> g_RasterizerConstantBuffer;
 RasteriserSettings g_RasteriserSettings;
 
 std::shared_ptr<RePiTexture> g_RenderTarget;
+std::shared_ptr<RePiTexture> g_SceneColor;
 std::shared_ptr<RePiTexture> g_Depth;
 
+// Scene is rasterized at a resolution that keeps the frame inside the budget, then upscaled
+static RePiResolutionScaler g_ResolutionScaler(1.f / 30.f, 0.5f, 1.f);
+
+// F10 toggles reusing last frame's shading for pixels the camera motion can reproject
+static std::shared_ptr<RePiTemporalReprojection> g_Temporal;
+static bool g_TemporalEnabled = false;
+
+// F9 toggles shading half the pixels per frame and reconstructing the other half
+static std::shared_ptr<RePiCheckerboard> g_Checkerboard;
+static bool g_CheckerboardEnabled = false;
+
+// F8 toggles coarse shading of flat tiles, rates come from the previous frame
+static std::shared_ptr<RePiShadingRateImage> g_ShadingRate;
+static bool g_ShadingRateEnabled = false;
+
+// F7 toggles deferred shading, draws fill the G-buffer and one tiled pass shades what stayed visible
+static std::shared_ptr<RePiGBuffer> g_GBuffer;
+static bool g_GBufferEnabled = false;
+
+// F6 toggles visibility buffer rendering, draws only record triangle ids and one tiled pass interpolates and shades
+static std::shared_ptr<RePiVisibilityBuffer> g_VisibilityBuffer;
+static bool g_VisibilityBufferEnabled = false;
+
+// F5 toggles point light shading, lights are culled into screen tile and depth slice clusters every frame
+static bool g_LightingEnabled = false;
+static const uint32_t LightCount = 256;
+
+// F4 toggles the sun's cascaded shadow maps, depth-only passes from the light before the scene
+static std::shared_ptr<RePiCascadedShadowMap> g_ShadowMap;
+static bool g_ShadowsEnabled = false;
+
 RePiGeometryStage g_Geometrystage;
 RePiRasterizerStage g_RasterizerStage;
 VertexShader g_VertexShader;
 PixelShader g_PixelShaderColorOnly;
 PixelShader g_PixelShaderDiffuse;
+PixelShader g_PixelShaderLit;
 
 // Global Camera
 static RePiFloat2 ScreenSize(WINDOW_WIDTH, WINDOW_HEIGHT);
@@ -218,33 +261,131 @@ static void Update(const float Tick)
         }
     }
 
-    for (auto& Animator : g_AnimatorList)
+    RePiAnimator::UpdateAll(g_AnimatorList, Tick);
+
+    RePi3DModel::UpdateAll(g_ModelList);
+}
+
+static void ResizeSceneTargets()
+{
+    auto& TexturePool = RePiTexturePool::Instance();
+    const RePiInt2 Size = g_ResolutionScaler.GetInternalSize(RePiInt2(int32_t(ScreenSize.x), int32_t(ScreenSize.y)));
+
+    g_SceneColor = TexturePool.Acquire(Size, RePiTextureFormat::eR8G8B8A8_UNORM_SRGB);
+    g_Depth = TexturePool.Acquire(Size, RePiTextureFormat::eR32_FLOAT);
+
+    // Entries are keyed by exact size, the targets of the old size would never be reused
+    TexturePool.Trim();
+
+    g_RasterizerStage.BindTarget(g_SceneColor);
+    g_RasterizerStage.BindDepth(g_Depth);
+}
+
+static void RenderShadowMap()
+{
+    if (nullptr == g_SceneColor)
     {
-        if (auto pAnimator = Animator.lock())
-        {
-            pAnimator->Update(Tick);
-        }
+        return;
     }
 
+    std::vector<RePiShadowCaster> Casters;
     for (auto& Model : g_ModelList)
     {
         if (auto pModel = Model.lock())
         {
-            pModel->Update();
+            const RePiMatrix World = pModel->GetTransform();
+            float Scale = 0.f;
+            for (const RePiFloat3& Axis : { RePiFloat3(1.f, 0.f, 0.f), RePiFloat3(0.f, 1.f, 0.f), RePiFloat3(0.f, 0.f, 1.f) })
+            {
+                const RePiFloat4 Scaled = World.transformVector(Axis);
+                Scale = RePiMath::max(Scale, RePiFloat3(Scaled.x, Scaled.y, Scaled.z).size());
+            }
+
+            // Bind pose bounds don't follow the animation, skinned meshes get some slack
+            const bool Skinned = !pModel->GetAnimator().expired();
+
+            for (auto& Mesh : pModel->mMeshList)
+            {
+                if (auto pMesh = Mesh.lock())
+                {
+                    RePiShadowCaster Caster;
+                    Caster.Mesh = pMesh;
+                    Caster.World = World;
+                    Caster.Bones = pModel->m_boneTransform;
+
+                    RePiFloat3 Center;
+                    float Radius = 0.f;
+                    pMesh->getBoundingSphere(Center, Radius);
+
+                    const RePiFloat4 WorldCenter = World.transformVector4(RePiFloat4(Center, 1.f));
+                    Caster.Center = RePiFloat3(WorldCenter.x, WorldCenter.y, WorldCenter.z);
+                    Caster.Radius = Radius * Scale * (Skinned ? 1.5f : 1.f);
+
+                    Casters.push_back(Caster);
+                }
+            }
         }
     }
+
+    const RePiFloat2 SceneSize = g_SceneColor->GetSize();
+    g_ShadowMap->Update(g_GeometryConstantBuffer->View, g_GeometryConstantBuffer->Projection, NearZ, RePiInt2(int32_t(SceneSize.x), int32_t(SceneSize.y)));
+    g_ShadowMap->Render(Casters, g_RasteriserSettings);
 }
 
 static void Render()
 {
+    if (g_ShadowsEnabled)
+    {
+        RenderShadowMap();
+    }
+
     if (nullptr != g_Depth)
     {
-        g_Depth->ClearData(0.f);
+        g_Depth->ClearData(1.f);
+    }
+
+    if (nullptr != g_SceneColor)
+    {
+        g_SceneColor->ClearColor(RePiColor::White);
+    }
+
+    if (g_GBufferEnabled && nullptr != g_SceneColor)
+    {
+        const RePiFloat2 SceneSize = g_SceneColor->GetSize();
+        g_GBuffer->Clear(RePiInt2(int32_t(SceneSize.x), int32_t(SceneSize.y)));
+    }
+
+    // The lit shader also runs for shadows alone, it then finds no point lights
+    if ((g_LightingEnabled || g_ShadowsEnabled) && nullptr != g_SceneColor)
+    {
+        static const std::vector<RePiPointLight> NoLights;
+
+        const RePiFloat2 SceneSize = g_SceneColor->GetSize();
+        g_RasterizerConstantBuffer->LightGrid->Build(
+            g_LightingEnabled ? g_RasterizerConstantBuffer->LightList : NoLights,
+            g_GeometryConstantBuffer->View,
+            g_GeometryConstantBuffer->Projection,
+            RePiInt2(int32_t(SceneSize.x), int32_t(SceneSize.y)),
+            NearZ,
+            FarZ);
+    }
+
+    if (g_VisibilityBufferEnabled && nullptr != g_SceneColor)
+    {
+        const RePiFloat2 SceneSize = g_SceneColor->GetSize();
+        g_VisibilityBuffer->Clear(RePiInt2(int32_t(SceneSize.x), int32_t(SceneSize.y)));
     }
 
-    if (nullptr != g_RenderTarget)
+    if (g_CheckerboardEnabled && nullptr != g_SceneColor)
     {
-        g_RenderTarget->ClearColor(RePiColor::White);
+        const RePiFloat2 SceneSize = g_SceneColor->GetSize();
+        g_Checkerboard->BeginFrame(RePiInt2(int32_t(SceneSize.x), int32_t(SceneSize.y)));
+    }
+
+    if (g_TemporalEnabled && nullptr != g_SceneColor)
+    {
+        const RePiFloat2 SceneSize = g_SceneColor->GetSize();
+        g_Temporal->BeginFrame(*g_GeometryConstantBuffer, RePiInt2(int32_t(SceneSize.x), int32_t(SceneSize.y)));
     }
 
     for (auto& Model : g_ModelList)
@@ -254,7 +395,7 @@ static void Render()
             g_GeometryConstantBuffer->World = pModel->GetTransform();
 
             memcpy(g_GeometryConstantBuffer->Bones, pModel->m_boneTransform, sizeof(RePiMatrix) * MaxBoneCapacity);
-            g_RasterizerStage.BindPixelShader(g_PixelShaderDiffuse);
+            g_RasterizerStage.BindPixelShader(g_LightingEnabled || g_ShadowsEnabled ? g_PixelShaderLit : g_PixelShaderDiffuse);
             for (auto& Mesh : pModel->mMeshList)
             {
                 if (auto pMesh = Mesh.lock())
@@ -287,6 +428,35 @@ static void Render()
             }
         }
     }
+
+    // Deferred and visibility shading cover every pixel, so there is no checkerboard half to resolve
+    if (g_VisibilityBufferEnabled && nullptr != g_SceneColor)
+    {
+        g_VisibilityBuffer->Shade(*g_SceneColor, g_RasterizerConstantBuffer, g_RasteriserSettings.sampleFilter);
+    }
+    else if (g_GBufferEnabled && nullptr != g_SceneColor)
+    {
+        g_GBuffer->Shade(*g_SceneColor, g_RasterizerConstantBuffer, g_RasteriserSettings.sampleFilter);
+    }
+    else if (g_CheckerboardEnabled && nullptr != g_SceneColor && nullptr != g_Depth)
+    {
+        g_Checkerboard->Resolve(*g_SceneColor, *g_Depth);
+    }
+
+    if (g_TemporalEnabled && nullptr != g_SceneColor && nullptr != g_Depth)
+    {
+        g_Temporal->EndFrame(*g_SceneColor, *g_Depth);
+    }
+
+    if (g_ShadingRateEnabled && nullptr != g_SceneColor)
+    {
+        g_ShadingRate->Generate(*g_SceneColor);
+    }
+
+    if (nullptr != g_SceneColor && nullptr != g_RenderTarget)
+    {
+        g_ResolutionScaler.Upscale(*g_SceneColor, *g_RenderTarget);
+    }
 }
 
 /* This function runs once at startup. */
@@ -320,6 +490,23 @@ SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[])
     }
     auto& ResourceManager = RePiResourceManager::Instance();
 
+    // Image Writer
+    Result = RePiImageWriter::StartUp(nullptr);
+    if (!Result)
+    {
+        return SDL_APP_FAILURE;
+    }
+    ResourceManager.SetTextureCompression(true);
+    ResourceManager.SetTextureBaking(true);
+
+    // Texture Pool
+    Result = RePiTexturePool::StartUp(nullptr);
+    if (!Result)
+    {
+        return SDL_APP_FAILURE;
+    }
+    auto& TexturePool = RePiTexturePool::Instance();
+
     // Scene
     if (auto pNewModel = ResourceManager.Create3DModel("data/3DObject/guardian/guardian.md5mesh").lock())
     {
@@ -383,6 +570,7 @@ SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[])
             Output.Normal = Buffer.World.transformVector(Output.Normal).getSafeNormal();
             Output.Binormal = Buffer.World.transformVector(Output.Binormal).getSafeNormal();
             Output.Tangent = Buffer.World.transformVector(Output.Tangent).getSafeNormal();
+            Output.TangentFrame = RePiVertex::EncodeTangentFrame(Output.Normal, Output.Tangent, Output.Binormal);
 
             return Output;
         };
@@ -398,34 +586,105 @@ SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[])
 
     g_PixelShaderDiffuse = [](const RePiVertex& Input, const std::weak_ptr<RePiMaterial>& Material, const std::weak_ptr<RasterizerConstantBuffer>& Buffer)->RePiLinearColor
         {
-            auto pDiffuse = Material.lock()->mImageList[0].lock();
+            return Material.lock()->GetSampler(RePiTextureUsages::eDiffuse).Sample(Input.TexCoord, Input.TexCoordDdx, Input.TexCoordDdy);
+        };
+
+    g_PixelShaderLit = [](const RePiVertex& Input, const std::weak_ptr<RePiMaterial>& Material, const std::weak_ptr<RasterizerConstantBuffer>& Buffer)->RePiLinearColor
+        {
+            static const float Ambient = 0.15f;
+            static const float SunIntensity = 0.85f;
+
+            auto pMaterial = Material.lock();
+            const RePiLinearColor Albedo = pMaterial->GetSampler(RePiTextureUsages::eDiffuse).Sample(Input.TexCoord, Input.TexCoordDdx, Input.TexCoordDdy);
 
-            return pDiffuse->SampleColor(Input.TexCoord);
+            auto pBuffer = Buffer.lock();
+            if (nullptr == pBuffer || nullptr == pBuffer->LightGrid)
+            {
+                return Albedo;
+            }
+
+            // The G-buffer keeps no tangent frame, deferred fragments light with the geometric normal
+            RePiVertex Surface = Input;
+            const RePiSampler& NormalMap = pMaterial->GetSampler(RePiTextureUsages::eNormals);
+            if (NormalMap.IsBound() && Input.HasTangentFrame())
+            {
+                const RePiLinearColor Texel = NormalMap.Sample(Input.TexCoord, Input.TexCoordDdx, Input.TexCoordDdy);
+
+                RePiFloat3 Tangent, Binormal, Normal;
+                Input.DecodeTangentFrame(Tangent, Binormal, Normal);
+                Surface.Normal = (Tangent * (Texel.r * 2.f - 1.f) + Binormal * (Texel.g * 2.f - 1.f) + Normal * (Texel.b * 2.f - 1.f)).getSafeNormal();
+            }
+
+            RePiLinearColor Light = pBuffer->LightGrid->ComputeLighting(Surface);
+
+            if (auto pShadowMap = pBuffer->ShadowMap)
+            {
+                const float NdotL = -RePiFloat3::dot(Surface.Normal.getSafeNormal(), pShadowMap->GetDirection());
+                if (NdotL > 0.f)
+                {
+                    const float Sun = SunIntensity * NdotL * pShadowMap->ComputeShadow(Input);
+                    Light = RePiLinearColor(Light.r + Sun, Light.g + Sun, Light.b + Sun, Light.a);
+                }
+            }
+
+            return RePiLinearColor(Albedo.r * (Ambient + Light.r), Albedo.g * (Ambient + Light.g), Albedo.b * (Ambient + Light.b), Albedo.a);
         };
 
     // Render Target
-    g_RenderTarget = std::make_shared<RePiTexture>();
+    g_RenderTarget = TexturePool.Acquire(RePiInt2(int32_t(ScreenSize.x), int32_t(ScreenSize.y)), RePiTextureFormat::eR8G8B8A8_UNORM_SRGB);
+
+    // Scene color and depth at the internal resolution
+    ResizeSceneTargets();
+
+    // Temporal reprojection
+    g_Temporal = std::make_shared<RePiTemporalReprojection>(4);
+
+    // Checkerboard rendering
+    g_Checkerboard = std::make_shared<RePiCheckerboard>();
 
-    g_RenderTarget->Create(RePiInt2(int32_t(ScreenSize.x), int32_t(ScreenSize.y)), RePiTextureFormat::eR8G8B8A8_UNORM);
+    // Variable rate shading
+    g_ShadingRate = std::make_shared<RePiShadingRateImage>();
 
-    // Depth 
-    g_Depth = std::make_shared<RePiTexture>();
+    // Deferred shading
+    g_GBuffer = std::make_shared<RePiGBuffer>();
 
-    g_Depth->Create(RePiInt2(int32_t(ScreenSize.x), int32_t(ScreenSize.y)), RePiTextureFormat::eR32_FLOAT);
+    // Visibility buffer
+    g_VisibilityBuffer = std::make_shared<RePiVisibilityBuffer>();
 
     // rasterizer constant buffer
     g_RasterizerConstantBuffer = std::make_shared<RasterizerConstantBuffer>();
+    g_RasterizerConstantBuffer->LightGrid = std::make_shared<RePiLightGrid>(16, 16);
+
+    // Sun shadows, four cascades over the first 3000 units in front of the camera
+    g_ShadowMap = std::make_shared<RePiCascadedShadowMap>(4, 1024, 3000.f, 0.75f, 1000.f);
+    g_ShadowMap->SetLight(RePiFloat3(1.f, -2.f, 1.f));
+
+    // Point lights scattered over the floor around the models, hues cycle so neighbours differ
+    g_RasterizerConstantBuffer->LightList.reserve(LightCount);
+    for (uint32_t i = 0; i < LightCount; ++i)
+    {
+        const float Hue = RePiMath::TWO_PI * float(i) * 0.618034f;
+        const RePiFloat3 Position(
+            -600.f + 800.f * float(i % 16) / 15.f,
+            40.f + 80.f * float((i * 7) % 3),
+            -600.f + 800.f * float(i / 16) / 15.f);
+        const RePiLinearColor Color(
+            0.5f + 0.5f * std::cos(Hue),
+            0.5f + 0.5f * std::cos(Hue - RePiMath::TWO_PI / 3.f),
+            0.5f + 0.5f * std::cos(Hue + RePiMath::TWO_PI / 3.f));
+
+        g_RasterizerConstantBuffer->LightList.emplace_back(Position, 120.f, Color, 1.5f);
+    }
 
     // rasterizer settings
     g_RasteriserSettings.cullMode = RePiCullMode::eBACK;
     g_RasteriserSettings.wireframe = false;
+    g_RasteriserSettings.sampleFilter = RePiSampleFilter::eFILTER_ANISOTROPIC;
 
 
     g_RasterizerStage.BindConstantBuffer(g_RasterizerConstantBuffer);
-    g_RasterizerStage.BindDepth(g_Depth);
 
     g_RasterizerStage.BindRasteriserSettings(g_RasteriserSettings);
-    g_RasterizerStage.BindTarget(g_RenderTarget);
 
     g_Geometrystage.BindConstantBuffer(g_GeometryConstantBuffer);
     g_Geometrystage.BindVertexShader(g_VertexShader);
@@ -443,6 +702,67 @@ SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event)
     if (event->type == SDL_EVENT_QUIT) {
         return SDL_APP_SUCCESS;  /* end the program, reporting success to the OS. */
     }
+
+    // F4 toggles sun shadows, F5 toggles point lights, F6 toggles the visibility buffer, F7 toggles deferred shading, F8 toggles variable rate shading, F9 toggles checkerboard rendering, F10 toggles temporal reprojection, F11 dumps a numbered screenshot, F12 toggles recording to a raw stream
+    if (event->type == SDL_EVENT_KEY_DOWN && !event->key.repeat) {
+        auto& ImageWriter = RePiImageWriter::Instance();
+
+        if (event->key.key == SDLK_F4) {
+            g_ShadowsEnabled = !g_ShadowsEnabled;
+            g_RasterizerConstantBuffer->ShadowMap = g_ShadowsEnabled ? g_ShadowMap : nullptr;
+            g_ShadowMap->Invalidate();
+            g_Temporal->Invalidate();
+            g_Checkerboard->Invalidate();
+        }
+        else if (event->key.key == SDLK_F5) {
+            g_LightingEnabled = !g_LightingEnabled;
+            g_Temporal->Invalidate();
+            g_Checkerboard->Invalidate();
+        }
+        // Only one of the two deferred paths is bound at a time
+        else if (event->key.key == SDLK_F6) {
+            g_VisibilityBufferEnabled = !g_VisibilityBufferEnabled;
+            g_GBufferEnabled = false;
+            g_VisibilityBuffer->Clear();
+            g_GBuffer->Clear();
+            g_RasterizerStage.BindGBuffer();
+            g_RasterizerStage.BindVisibilityBuffer(g_VisibilityBufferEnabled ? g_VisibilityBuffer : std::weak_ptr<RePiVisibilityBuffer>());
+        }
+        else if (event->key.key == SDLK_F7) {
+            g_GBufferEnabled = !g_GBufferEnabled;
+            g_VisibilityBufferEnabled = false;
+            g_GBuffer->Clear();
+            g_VisibilityBuffer->Clear();
+            g_RasterizerStage.BindVisibilityBuffer();
+            g_RasterizerStage.BindGBuffer(g_GBufferEnabled ? g_GBuffer : std::weak_ptr<RePiGBuffer>());
+        }
+        else if (event->key.key == SDLK_F8) {
+            g_ShadingRateEnabled = !g_ShadingRateEnabled;
+            g_ShadingRate->Resize();
+            g_RasterizerStage.BindShadingRate(g_ShadingRateEnabled ? g_ShadingRate : std::weak_ptr<RePiShadingRateImage>());
+        }
+        else if (event->key.key == SDLK_F9) {
+            g_CheckerboardEnabled = !g_CheckerboardEnabled;
+            g_Checkerboard->Invalidate();
+            g_RasterizerStage.BindCheckerboard(g_CheckerboardEnabled ? g_Checkerboard : std::weak_ptr<RePiCheckerboard>());
+        }
+        else if (event->key.key == SDLK_F10) {
+            g_TemporalEnabled = !g_TemporalEnabled;
+            g_Temporal->Invalidate();
+            g_RasterizerStage.BindTemporal(g_TemporalEnabled ? g_Temporal : std::weak_ptr<RePiTemporalReprojection>());
+        }
+        else if (event->key.key == SDLK_F11) {
+            g_RenderTarget->SaveSequence("data/capture");
+        }
+        else if (event->key.key == SDLK_F12) {
+            if (ImageWriter.IsStreamOpen()) {
+                ImageWriter.CloseStream();
+            }
+            else {
+                ImageWriter.OpenStream("data/capture.y4m", RePiInt2(WINDOW_WIDTH, WINDOW_HEIGHT));
+            }
+        }
+    }
     return SDL_APP_CONTINUE;  /* carry on with the program! */
 }
 
@@ -459,8 +779,19 @@ SDL_AppResult SDL_AppIterate(void* appstate)
     float Tick = static_cast<float>(elapsedTime.count());
 
     Update(Tick);
+
+    if (g_ResolutionScaler.Update(Tick))
+    {
+        ResizeSceneTargets();
+    }
+
     Render();
 
+    if (RePiImageWriter::Instance().IsStreamOpen())
+    {
+        g_RenderTarget->StreamFrame();
+    }
+
     // Lock the texture to update pixels
     void* pixels;
     int pitch;
@@ -489,6 +820,22 @@ SDL_AppResult SDL_AppIterate(void* appstate)
 /* This function runs once at shutdown. */
 void SDL_AppQuit(void* appstate, SDL_AppResult result)
 {
+    // Pending saves finish before the writer goes away
+    if (RePiImageWriter::IsReady())
+    {
+        RePiImageWriter::ShutDown();
+    }
+
+    g_RenderTarget.reset();
+    g_SceneColor.reset();
+    g_Depth.reset();
+
+    if (RePiTexturePool::IsReady())
+    {
+        RePiLog(RePiLogLevel::eINFO, "Texture pool peak: " + std::to_string(RePiTexturePool::Instance().GetPeakBytes()) + " bytes");
+        RePiTexturePool::ShutDown();
+    }
+
     SDL_DestroyTexture(texture);
     /* SDL will clean up the window/renderer for us. */
 }
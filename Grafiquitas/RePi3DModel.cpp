@@ -3,8 +3,140 @@
 #include "RePiAnimator.h"
 #include "RePiMaterial.h"
 
+RePiFloat4 RePiVertex::EncodeTangentFrame(
+    const RePiFloat3& FrameNormal,
+    const RePiFloat3& FrameTangent,
+    const RePiFloat3& FrameBinormal)
+{
+    // Keeps w off zero, where its sign, and with it the handedness, would be lost
+    static const float Bias = 1.f / 32767.f;
+
+    const RePiFloat3 N = FrameNormal.getSafeNormal();
+    if (N.sizeSquared() < 0.5f)
+    {
+        return RePiFloat4::ZERO;
+    }
+
+    // Gram-Schmidt, meshes without texcoords get any tangent perpendicular to the normal
+    RePiFloat3 T = (FrameTangent - N * RePiFloat3::dot(N, FrameTangent)).getSafeNormal();
+    if (T.sizeSquared() < 0.5f)
+    {
+        const RePiFloat3 Axis = std::abs(N.x) < 0.9f ? RePiFloat3(1.f, 0.f, 0.f) : RePiFloat3(0.f, 1.f, 0.f);
+        T = RePiFloat3::cross(Axis, N).getSafeNormal();
+    }
+    const RePiFloat3 B = RePiFloat3::cross(N, T);
+    const bool Mirrored = RePiFloat3::dot(B, FrameBinormal) < 0.f;
+
+    // Rotation with T, B and N as its columns
+    RePiFloat4 q;
+    const float Trace = T.x + B.y + N.z;
+    if (Trace > 0.f)
+    {
+        const float s = 0.5f / std::sqrt(Trace + 1.f);
+        q = RePiFloat4((B.z - N.y) * s, (N.x - T.z) * s, (T.y - B.x) * s, 0.25f / s);
+    }
+    else if (T.x > B.y && T.x > N.z)
+    {
+        const float s = 2.f * std::sqrt(1.f + T.x - B.y - N.z);
+        q = RePiFloat4(0.25f * s, (B.x + T.y) / s, (N.x + T.z) / s, (B.z - N.y) / s);
+    }
+    else if (B.y > N.z)
+    {
+        const float s = 2.f * std::sqrt(1.f + B.y - T.x - N.z);
+        q = RePiFloat4((B.x + T.y) / s, 0.25f * s, (N.y + B.z) / s, (N.x - T.z) / s);
+    }
+    else
+    {
+        const float s = 2.f * std::sqrt(1.f + N.z - T.x - B.y);
+        q = RePiFloat4((N.x + T.z) / s, (N.y + B.z) / s, 0.25f * s, (T.y - B.x) / s);
+    }
+
+    // q and -q are the same rotation, w >= 0 frees the sign for the handedness
+    if (q.w < 0.f)
+    {
+        q = q * -1.f;
+    }
+    if (q.w < Bias)
+    {
+        const float Scale = std::sqrt(1.f - Bias * Bias);
+        q = RePiFloat4(q.x * Scale, q.y * Scale, q.z * Scale, Bias);
+    }
+
+    return Mirrored ? q * -1.f : q;
+}
+
+float RePiVertex::AlignTangentFrames(
+    const RePiFloat4& Provoking,
+    RePiFloat4& Second,
+    RePiFloat4& Third)
+{
+    // q and -q are the same rotation, but blending across hemispheres cancels toward zero
+    auto Dot = [](const RePiFloat4& a, const RePiFloat4& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    };
+
+    if (Dot(Provoking, Second) < 0.f)
+    {
+        Second = Second * -1.f;
+    }
+    if (Dot(Provoking, Third) < 0.f)
+    {
+        Third = Third * -1.f;
+    }
+
+    return Provoking.w < 0.f ? -1.f : 1.f;
+}
+
+void RePiVertex::DecodeTangentFrame(
+    RePiFloat3& FrameTangent,
+    RePiFloat3& FrameBinormal,
+    RePiFloat3& FrameNormal) const
+{
+    const float LengthSquared = TangentFrame.x * TangentFrame.x + TangentFrame.y * TangentFrame.y + TangentFrame.z * TangentFrame.z + TangentFrame.w * TangentFrame.w;
+    if (LengthSquared <= 0.f)
+    {
+        FrameTangent = Tangent;
+        FrameBinormal = Binormal;
+        FrameNormal = Normal;
+        return;
+    }
+
+    const float InvLength = 1.f / std::sqrt(LengthSquared);
+    const float x = TangentFrame.x * InvLength;
+    const float y = TangentFrame.y * InvLength;
+    const float z = TangentFrame.z * InvLength;
+    const float w = TangentFrame.w * InvLength;
+
+    FrameTangent = RePiFloat3(1.f - 2.f * (y * y + z * z), 2.f * (x * y + w * z), 2.f * (x * z - w * y));
+    FrameBinormal = RePiFloat3(2.f * (x * y - w * z), 1.f - 2.f * (x * x + z * z), 2.f * (y * z + w * x));
+    FrameNormal = RePiFloat3(2.f * (x * z + w * y), 2.f * (y * z - w * x), 1.f - 2.f * (x * x + y * y));
+
+    if (TangentHandedness < 0.f)
+    {
+        FrameBinormal = FrameBinormal * -1.f;
+    }
+}
+
+RePiFloat3 RePiVertex::GetFrameNormal() const
+{
+    const float LengthSquared = TangentFrame.x * TangentFrame.x + TangentFrame.y * TangentFrame.y + TangentFrame.z * TangentFrame.z + TangentFrame.w * TangentFrame.w;
+    if (LengthSquared <= 0.f)
+    {
+        return Normal;
+    }
+
+    // Third column of the rotation, the rest of the frame isn't needed for plain lighting
+    const float Scale = 2.f / LengthSquared;
+    const float x = TangentFrame.x, y = TangentFrame.y, z = TangentFrame.z, w = TangentFrame.w;
+
+    return RePiFloat3((x * z + w * y) * Scale, (y * z - w * x) * Scale, 1.f - (x * x + y * y) * Scale);
+}
+
 RePiMesh::RePiMesh()
     : m_topology(RePiVertexTopology::eUNDEFINED)
+    , m_boundsMin(RePiFloat3::ZERO)
+    , m_boundsMax(RePiFloat3::ZERO)
 {
     m_vertexBuffer = std::make_shared<std::vector<RePiVertex>>();
 
@@ -21,6 +153,18 @@ RePiMesh::~RePiMesh()
 void RePiMesh::addVertex(
     const RePiVertex& vertex)
 {
+    const RePiFloat3 position(vertex.Position.x, vertex.Position.y, vertex.Position.z);
+    if (m_vertexBuffer->empty())
+    {
+        m_boundsMin = position;
+        m_boundsMax = position;
+    }
+    else
+    {
+        m_boundsMin = RePiFloat3(RePiMath::min(m_boundsMin.x, position.x), RePiMath::min(m_boundsMin.y, position.y), RePiMath::min(m_boundsMin.z, position.z));
+        m_boundsMax = RePiFloat3(RePiMath::max(m_boundsMax.x, position.x), RePiMath::max(m_boundsMax.y, position.y), RePiMath::max(m_boundsMax.z, position.z));
+    }
+
     m_vertexBuffer->push_back(vertex);
 }
 
@@ -62,6 +206,14 @@ RePiVertexTopology RePiMesh::getTopology() const
     return m_topology;
 }
 
+void RePiMesh::getBoundingSphere(
+    RePiFloat3& center,
+    float& radius) const
+{
+    center = (m_boundsMin + m_boundsMax) * 0.5f;
+    radius = (m_boundsMax - m_boundsMin).size() * 0.5f;
+}
+
 /*void RePiMesh::BindToCommandBuffer(const std::weak_ptr<RePiCommandBuffer>& CommandBuffer) const
 {
     if (auto pCommandBuffer = CommandBuffer.lock())
@@ -176,3 +328,18 @@ void RePi3DModel::Update()
         }
     }
 }
+
+void RePi3DModel::UpdateAll(
+    const std::vector<std::weak_ptr<RePi3DModel>>& Models)
+{
+    const int32_t ModelCount = static_cast<int32_t>(Models.size());
+
+#pragma omp parallel for
+    for (int32_t i = 0; i < ModelCount; ++i)
+    {
+        if (auto pModel = Models[i].lock())
+        {
+            pModel->Update();
+        }
+    }
+}
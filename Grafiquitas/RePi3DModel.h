@@ -19,11 +19,41 @@ public:
         Normal(VertexNormal),
         Binormal(VertexBinormal),
         Tangent(VertexTangent),
-        BoneWeight(RePiFloat4::ZERO)
+        TexCoordDdx(RePiFloat2::ZERO),
+        TexCoordDdy(RePiFloat2::ZERO),
+        BoneWeight(RePiFloat4::ZERO),
+        TangentFrame(RePiFloat4::ZERO),
+        TangentHandedness(1.f)
     {
         memset(&BoneIndex[0], 0, sizeof(uint32_t) * 4);
     }
 
+    // Packs the frame into a unit quaternion, a negative w flips the binormal
+    static RePiFloat4 EncodeTangentFrame(
+        const RePiFloat3& FrameNormal,
+        const RePiFloat3& FrameTangent,
+        const RePiFloat3& FrameBinormal);
+
+    // Flips Second and Third onto Provoking's side of the quaternion sphere, returns Provoking's handedness
+    static float AlignTangentFrames(
+        const RePiFloat4& Provoking,
+        RePiFloat4& Second,
+        RePiFloat4& Third);
+
+    // Interpolated frames come in denormalized, the decode normalizes them first
+    // Handedness is read from TangentHandedness, the sign of an interpolated w is meaningless
+    void DecodeTangentFrame(
+        RePiFloat3& FrameTangent,
+        RePiFloat3& FrameBinormal,
+        RePiFloat3& FrameNormal) const;
+
+    RePiFloat3 GetFrameNormal() const;
+
+    bool HasTangentFrame() const
+    {
+        return TangentFrame.x * TangentFrame.x + TangentFrame.y * TangentFrame.y + TangentFrame.z * TangentFrame.z + TangentFrame.w * TangentFrame.w > 0.25f;
+    }
+
 public:
     uint32_t BoneIndex[4];
 
@@ -38,6 +68,17 @@ public:
     RePiFloat3 Binormal;
 
     RePiFloat3 Tangent;
+
+    // Screen-space texcoord derivatives, filled by the rasterizer for the pixel shader
+    RePiFloat2 TexCoordDdx;
+
+    RePiFloat2 TexCoordDdy;
+
+    // Tangent, binormal and normal as a quaternion (x, y, z, w), the only frame varying the rasterizer walks
+    RePiFloat4 TangentFrame;
+
+    // -1 flips the binormal, the rasterizer sets it from the provoking vertex
+    float TangentHandedness;
 };
 
 struct RePiLine
@@ -104,6 +145,11 @@ public:
 
     RePiVertexTopology getTopology() const;
 
+    // Bind pose bounds, model space
+    void getBoundingSphere(
+        RePiFloat3& center,
+        float& radius) const;
+
     //void BindToCommandBuffer(const std::weak_ptr<RePiCommandBuffer>& CommandBuffer) const;
 
 private:
@@ -111,6 +157,8 @@ private:
     std::shared_ptr<std::vector<uint32_t>> m_indexBuffer;
     std::weak_ptr<RePiMaterial> mMaterial;
     RePiVertexTopology m_topology;
+    RePiFloat3 m_boundsMin;
+    RePiFloat3 m_boundsMax;
 };
 
 class RePi3DModel : public RePiMetadata
@@ -141,6 +189,10 @@ public:
 
     void Update();
 
+    // Bone transfer for every model, run after RePiAnimator::UpdateAll
+    static void UpdateAll(
+        const std::vector<std::weak_ptr<RePi3DModel>>& Models);
+
     std::vector<std::weak_ptr<RePiMesh>> mMeshList;
     RePiMatrix m_boneTransform[MaxBoneCapacity];
 protected:
@@ -2,22 +2,18 @@
 
 #include "RePi3DModel.h"
 
+#include <algorithm>
+
 RePiBone::RePiBone(
     const std::string& Name,
     const uint32_t Index)
-    : mFinalTransform(RePiMatrix::IDENTITY)
-    , mTransform(RePiMatrix::IDENTITY)
+    : mTransform(RePiMatrix::IDENTITY)
     , mOffset(RePiMatrix::IDENTITY)
     , mIndex(Index)
     , mName(Name)
 {
 }
 
-RePiMatrix RePiBone::GetFinalTransform() const
-{
-    return mFinalTransform;
-}
-
 RePiMatrix RePiBone::GetTransform() const
 {
     return mTransform;
@@ -38,12 +34,6 @@ std::string RePiBone::GetName() const
     return mName;
 }
 
-void RePiBone::SetFinalTransform(
-    const RePiMatrix& FinalTransform)
-{
-    mFinalTransform = FinalTransform;
-}
-
 void RePiBone::SetTransform(
     const RePiMatrix& Transform)
 {
@@ -111,64 +101,114 @@ uint32_t RePiSkeleton::GetBoneCount() const
     return static_cast<uint32_t>(mBoneMap.size());
 }
 
-RePiKeyFrameData::RePiKeyFrameData(
-    const float Time,
-    const RePiFloat3& Position,
-    const RePiFloat3& Scale,
-    const RePiQuaternion& Rotation)
-    : mTime(Time)
-    , mPosition(Position)
-    , mScale(Scale)
-    , mRotation(Rotation)
+void RePiSkeleton::BuildHierarchy()
 {
-}
+    mHierarchyBones.clear();
+    mHierarchyParents.clear();
+    mHierarchyTransforms.clear();
+    mHierarchyOffsets.clear();
 
-RePiChannel::RePiChannel(
-    const uint32_t BoneIndex) :
-    mBoneIndex(BoneIndex)
-{
-}
+    // Breadth first, the slot list doubles as the queue
+    std::vector<std::shared_ptr<RePiBone>> Slots;
+    if (auto pRoot = mRootBone.lock())
+    {
+        Slots.push_back(pRoot);
+        mHierarchyParents.push_back(-1);
+    }
 
-RePiChannel::~RePiChannel()
-{
-    for (auto& Key : mScale)
+    for (size_t Slot = 0; Slot < Slots.size(); ++Slot)
     {
-        Key.reset();
+        for (auto& Child : Slots[Slot]->mChildren)
+        {
+            if (auto pChild = Child.lock())
+            {
+                Slots.push_back(pChild);
+                mHierarchyParents.push_back(static_cast<int32_t>(Slot));
+            }
+        }
     }
-    mScale.clear();
 
-    for (auto& Key : mRotation)
+    mHierarchyBones.reserve(Slots.size());
+    mHierarchyTransforms.reserve(Slots.size());
+    mHierarchyOffsets.reserve(Slots.size());
+    for (auto& Bone : Slots)
     {
-        Key.reset();
+        mHierarchyBones.push_back(Bone->GetIndex());
+        mHierarchyTransforms.push_back(Bone->GetTransform());
+        mHierarchyOffsets.push_back(Bone->GetOffset());
     }
-    mRotation.clear();
+}
+
+uint32_t RePiSkeleton::GetHierarchySize() const
+{
+    return static_cast<uint32_t>(mHierarchyBones.size());
+}
+
+const std::vector<uint32_t>& RePiSkeleton::GetHierarchyBones() const
+{
+    return mHierarchyBones;
+}
 
-    for (auto& Key : mPosition)
+const std::vector<int32_t>& RePiSkeleton::GetHierarchyParents() const
+{
+    return mHierarchyParents;
+}
+
+const std::vector<RePiMatrix>& RePiSkeleton::GetHierarchyTransforms() const
+{
+    return mHierarchyTransforms;
+}
+
+const std::vector<RePiMatrix>& RePiSkeleton::GetHierarchyOffsets() const
+{
+    return mHierarchyOffsets;
+}
+
+// Assimp hands keys over in order, out of order ones still land sorted
+template<typename KeyType>
+static void InsertKey(
+    std::vector<float>& KeyTimes,
+    std::vector<KeyType>& Keys,
+    const float Time,
+    const KeyType& Key)
+{
+    if (KeyTimes.empty() || KeyTimes.back() <= Time)
     {
-        Key.reset();
+        KeyTimes.push_back(Time);
+        Keys.push_back(Key);
+        return;
     }
-    mPosition.clear();
+
+    const auto It = std::upper_bound(KeyTimes.begin(), KeyTimes.end(), Time);
+    Keys.insert(Keys.begin() + (It - KeyTimes.begin()), Key);
+    KeyTimes.insert(It, Time);
+}
+
+RePiChannel::RePiChannel(
+    const uint32_t BoneIndex) :
+    mBoneIndex(BoneIndex)
+{
 }
 
 void RePiChannel::AddScaleKey(
     const RePiFloat3& Scale,
     const float Time)
 {
-    AddKeyFrameData(mScale, Time, RePiFloat3::ZERO, Scale);
+    InsertKey(mScaleTimes, mScaleKeys, Time, Scale);
 }
 
 void RePiChannel::AddRotationKey(
     const RePiQuaternion& Rotation,
     const float Time)
 {
-    AddKeyFrameData(mRotation, Time, RePiFloat3::ZERO, RePiFloat3::ZERO, Rotation);
+    InsertKey(mRotationTimes, mRotationKeys, Time, Rotation);
 }
 
 void RePiChannel::AddPositionKey(
     const RePiFloat3& Position,
     const float Time)
 {
-    AddKeyFrameData(mPosition, Time, Position);
+    InsertKey(mPositionTimes, mPositionKeys, Time, Position);
 }
 
 uint32_t RePiChannel::GetBoneIndex() const
@@ -177,53 +217,67 @@ uint32_t RePiChannel::GetBoneIndex() const
 }
 
 RePiMatrix RePiChannel::GetTransformByTime(
-    const float CurrentCycleTime)
+    const float CurrentCycleTime) const
+{
+    RePiChannelCursor Keys;
+    Keys.Scale = FindKeyIndex(mScaleTimes, CurrentCycleTime);
+    Keys.Rotation = FindKeyIndex(mRotationTimes, CurrentCycleTime);
+    Keys.Position = FindKeyIndex(mPositionTimes, CurrentCycleTime);
+
+    return ComposeTransform(CurrentCycleTime, Keys);
+}
+
+RePiMatrix RePiChannel::GetTransformByTime(
+    const float CurrentCycleTime,
+    RePiChannelCursor& Cursor) const
+{
+    Cursor.Scale = AdvanceKeyIndex(mScaleTimes, CurrentCycleTime, Cursor.Scale);
+    Cursor.Rotation = AdvanceKeyIndex(mRotationTimes, CurrentCycleTime, Cursor.Rotation);
+    Cursor.Position = AdvanceKeyIndex(mPositionTimes, CurrentCycleTime, Cursor.Position);
+
+    return ComposeTransform(CurrentCycleTime, Cursor);
+}
+
+RePiMatrix RePiChannel::ComposeTransform(
+    const float Time,
+    const RePiChannelCursor& Keys) const
 {
     RePiMatrix Transform = RePiMatrix::IDENTITY;
 
-    auto ScaleKey = GetKeyFrameDataByTime(CurrentCycleTime, mScale);
-    if (auto pScaleKey = ScaleKey.lock())
+    if (!mScaleKeys.empty())
     {
-        RePiFloat3& Data = pScaleKey->mScale;
+        const float Interpolation = GetKeyInterpolation(mScaleTimes, Keys.Scale, Time);
 
-        if (auto pNextScaleKey = pScaleKey->mNext.lock())
+        RePiFloat3 Data = mScaleKeys[Keys.Scale];
+        if (Interpolation > 0.f)
         {
-            RePiFloat3& NextData = pNextScaleKey->mScale;
-
-            float Interpolation = (CurrentCycleTime - pScaleKey->mTime) / (pNextScaleKey->mTime - pScaleKey->mTime);
-            Data = RePiMath::lerp(Data, NextData, Interpolation);
+            Data = RePiMath::lerp(Data, mScaleKeys[Keys.Scale + 1], Interpolation);
         }
 
         Transform = RePiScaleMatrix(Data);
     }
-    
-    auto RotationKey = GetKeyFrameDataByTime(CurrentCycleTime, mRotation);
-    if (auto pRotationKey = RotationKey.lock())
+
+    if (!mRotationKeys.empty())
     {
-        RePiQuaternion& Data = pRotationKey->mRotation;
+        const float Interpolation = GetKeyInterpolation(mRotationTimes, Keys.Rotation, Time);
 
-        if (auto pNextRotationKey = pRotationKey->mNext.lock())
+        RePiQuaternion Data = mRotationKeys[Keys.Rotation];
+        if (Interpolation > 0.f)
         {
-            RePiQuaternion& NextData = pNextRotationKey->mRotation;
-
-            float Interpolation = (CurrentCycleTime - pRotationKey->mTime) / (pNextRotationKey->mTime - pRotationKey->mTime);
-            Data = RePiQuaternion::slerp(Data, NextData, Interpolation);
+            Data = RePiQuaternion::slerp(Data, mRotationKeys[Keys.Rotation + 1], Interpolation);
         }
 
         Transform = Transform * RePiRotationMatrix::make(Data);
     }
 
-    auto PositionKey = GetKeyFrameDataByTime(CurrentCycleTime, mPosition);
-    if (auto pPositionKey = PositionKey.lock())
+    if (!mPositionKeys.empty())
     {
-        RePiFloat3& Data = pPositionKey->mPosition;
+        const float Interpolation = GetKeyInterpolation(mPositionTimes, Keys.Position, Time);
 
-        if (auto pNextPositionKey = pPositionKey->mNext.lock())
+        RePiFloat3 Data = mPositionKeys[Keys.Position];
+        if (Interpolation > 0.f)
         {
-            RePiFloat3& NextData = pNextPositionKey->mPosition;
-
-            float Interpolation = (CurrentCycleTime - pPositionKey->mTime) / (pNextPositionKey->mTime - pPositionKey->mTime);
-            Data = RePiMath::lerp(Data, NextData, Interpolation);
+            Data = RePiMath::lerp(Data, mPositionKeys[Keys.Position + 1], Interpolation);
         }
 
         Transform = Transform * RePiTranslationMatrix(Data);
@@ -232,46 +286,62 @@ RePiMatrix RePiChannel::GetTransformByTime(
     return Transform;
 }
 
-void RePiChannel::AddKeyFrameData(
-    std::vector<std::shared_ptr<RePiKeyFrameData>>& KeyFrames,
-    const float Time,
-    const RePiFloat3& Position,
-    const RePiFloat3& Scale,
-    const RePiQuaternion& Rotation)
+uint32_t RePiChannel::FindKeyIndex(
+    const std::vector<float>& KeyTimes,
+    const float Time)
 {
-    auto KeyFrame = std::make_shared<RePiKeyFrameData>(Time, Position, Scale, Rotation);
-
-    if (!KeyFrames.empty())
+    const auto It = std::upper_bound(KeyTimes.begin(), KeyTimes.end(), Time);
+    if (It == KeyTimes.begin())
     {
-        KeyFrames.back()->mNext = KeyFrame;
+        return 0;
     }
-    KeyFrames.push_back(KeyFrame);
+
+    return static_cast<uint32_t>(It - KeyTimes.begin()) - 1;
 }
 
-std::weak_ptr<RePiKeyFrameData> RePiChannel::GetKeyFrameDataByTime(
-    const float CurrentCicleTime,
-    const std::vector<std::shared_ptr<RePiKeyFrameData>>& KeyFrames) const
+uint32_t RePiChannel::AdvanceKeyIndex(
+    const std::vector<float>& KeyTimes,
+    const float Time,
+    const uint32_t Hint)
 {
-    if (KeyFrames.empty())
+    // A frame rarely crosses more than a key or two, anything further is treated as a seek
+    static const uint32_t MaxSteps = 4;
+
+    if (Hint >= KeyTimes.size() || (Hint > 0 && Time < KeyTimes[Hint]))
     {
-        return std::weak_ptr<RePiKeyFrameData>();
+        return FindKeyIndex(KeyTimes, Time);
     }
 
-    std::weak_ptr<RePiKeyFrameData> KeyFrame = KeyFrames[0];
-
-    for (auto& CurrentKeyFrame : KeyFrames)
+    uint32_t Index = Hint;
+    for (uint32_t Step = 0; Index + 1 < KeyTimes.size() && KeyTimes[Index + 1] <= Time; ++Step)
     {
-        if (CurrentCicleTime < CurrentKeyFrame->mTime)
-        {
-            break;
-        }
-        else
+        if (Step == MaxSteps)
         {
-            KeyFrame = CurrentKeyFrame;
+            return FindKeyIndex(KeyTimes, Time);
         }
+        ++Index;
     }
 
-    return KeyFrame;
+    return Index;
+}
+
+float RePiChannel::GetKeyInterpolation(
+    const std::vector<float>& KeyTimes,
+    const uint32_t Index,
+    const float Time)
+{
+    if (Index + 1 >= KeyTimes.size())
+    {
+        return 0.f;
+    }
+
+    const float Span = KeyTimes[Index + 1] - KeyTimes[Index];
+    if (Span <= 0.f)
+    {
+        return 0.f;
+    }
+
+    return RePiMath::clamp((Time - KeyTimes[Index]) / Span, 0.f, 1.f);
 }
 
 RePiAnimation::RePiAnimation(
@@ -309,6 +379,12 @@ std::weak_ptr<RePiChannel> RePiAnimation::GetChannel(
             NewChannel = std::make_shared<RePiChannel>(BoneIndex);
 
             mChannelMap[BoneName] = NewChannel;
+
+            if (BoneIndex >= mChannelList.size())
+            {
+                mChannelList.resize(BoneIndex + 1);
+            }
+            mChannelList[BoneIndex] = NewChannel;
         }
 
         return NewChannel;
@@ -320,18 +396,23 @@ std::weak_ptr<RePiChannel> RePiAnimation::GetChannel(
 std::weak_ptr<RePiChannel> RePiAnimation::GetChannel(
     const uint32_t BoneIndex) const
 {
-    std::shared_ptr<RePiChannel> NewChannel = nullptr;
-    for (auto& It : mChannelMap)
+    if (BoneIndex >= mChannelList.size())
     {
-        NewChannel = It.second;
+        return std::weak_ptr<RePiChannel>();
+    }
 
-        if (nullptr != NewChannel && NewChannel->GetBoneIndex() == BoneIndex)
-        {
-            return NewChannel;
-        }
+    return mChannelList[BoneIndex];
+}
+
+const RePiChannel* RePiAnimation::GetChannelByBone(
+    const uint32_t BoneIndex) const
+{
+    if (BoneIndex >= mChannelList.size())
+    {
+        return nullptr;
     }
 
-    return std::weak_ptr<RePiChannel>();
+    return mChannelList[BoneIndex].get();
 }
 
 float RePiAnimation::GetCycleTime() const
@@ -372,10 +453,7 @@ void RePiAnimator::SetSkeleton(
 {
     mSkeleton = Skeleton;
 
-    if (auto pSkeleton = mSkeleton.lock())
-    {
-        UpdateBoneTransform(pSkeleton->GetRoot(), RePiMatrix::IDENTITY);
-    }
+    UpdatePose();
 }
 
 RePiMatrix RePiAnimator::GetBoneTransform(
@@ -420,6 +498,7 @@ void RePiAnimator::PlayAnimation(
     }
 
     mCurrentCycleTime = 0.f;
+    std::fill(std::begin(mChannelCursor), std::end(mChannelCursor), RePiChannelCursor());
 }
 
 void RePiAnimator::StopAnimation()
@@ -464,43 +543,73 @@ void RePiAnimator::Update(
         if (mCurrentCycleTime > pActiveAnimation->GetCycleTime())
         {
             mCurrentCycleTime = 0.f;
+            std::fill(std::begin(mChannelCursor), std::end(mChannelCursor), RePiChannelCursor());
         }
 
-        if (auto pSkeleton = mSkeleton.lock())
+        UpdatePose();
+    }
+}
+
+void RePiAnimator::UpdateAll(
+    const std::vector<std::weak_ptr<RePiAnimator>>& Animators,
+    const float Tick)
+{
+    const int32_t AnimatorCount = static_cast<int32_t>(Animators.size());
+
+    // Clips and skeletons differ in cost, dynamic keeps every core busy
+#pragma omp parallel for schedule(dynamic)
+    for (int32_t i = 0; i < AnimatorCount; ++i)
+    {
+        if (auto pAnimator = Animators[i].lock())
         {
-            UpdateBoneTransform(pSkeleton->GetRoot(), RePiMatrix::IDENTITY);
+            pAnimator->Update(Tick);
         }
     }
 }
 
-void RePiAnimator::UpdateBoneTransform(
-    const std::weak_ptr<RePiBone>& Bone, const RePiMatrix& Transform)
+void RePiAnimator::UpdatePose()
 {
-    if (auto pBone = Bone.lock())
+    auto pSkeleton = mSkeleton.lock();
+    if (nullptr == pSkeleton)
+    {
+        return;
+    }
+
+    const uint32_t SlotCount = pSkeleton->GetHierarchySize();
+    const uint32_t* Bones = pSkeleton->GetHierarchyBones().data();
+    const int32_t* Parents = pSkeleton->GetHierarchyParents().data();
+    const RePiMatrix* Transforms = pSkeleton->GetHierarchyTransforms().data();
+    const RePiMatrix* Offsets = pSkeleton->GetHierarchyOffsets().data();
+
+    if (mModelTransform.size() != SlotCount)
     {
-        RePiMatrix FinalTransform = pBone->GetTransform();
+        mModelTransform.resize(SlotCount);
+    }
+
+    auto pActiveAnimation = mActiveAnimation.lock();
+
+    for (uint32_t Slot = 0; Slot < SlotCount; ++Slot)
+    {
+        const uint32_t BoneIndex = Bones[Slot];
 
-        if (auto pActiveAnimation = mActiveAnimation.lock())
+        RePiMatrix Transform = Transforms[Slot];
+        if (nullptr != pActiveAnimation)
         {
-            if (auto pChannel = pActiveAnimation->GetChannel(pBone->GetIndex()).lock())
+            if (const RePiChannel* pChannel = pActiveAnimation->GetChannelByBone(BoneIndex))
             {
-                FinalTransform = pChannel->GetTransformByTime(mCurrentCycleTime);
+                Transform = pChannel->GetTransformByTime(mCurrentCycleTime, mChannelCursor[BoneIndex]);
             }
         }
-        FinalTransform = FinalTransform * Transform;
 
-        for (size_t i = 0; i < pBone->mChildren.size(); ++i)
+        if (Parents[Slot] >= 0)
         {
-            if (auto pChild = pBone->mChildren[i].lock())
-            {
-                UpdateBoneTransform(pChild, FinalTransform);
-            }
+            Transform = Transform * mModelTransform[Parents[Slot]];
         }
+        mModelTransform[Slot] = Transform;
 
-        pBone->SetFinalTransform(FinalTransform);
-
-        mJoinTransform[pBone->GetIndex()] = pBone->GetFinalTransform();
+        // Skeletons are shared between animators, the pose only goes to this animator's arrays
+        mJoinTransform[BoneIndex] = Transform;
 
-        mBoneTransform[pBone->GetIndex()] = (pBone->GetOffset() * pBone->GetFinalTransform());
+        mBoneTransform[BoneIndex] = Offsets[Slot] * Transform;
     }
 }
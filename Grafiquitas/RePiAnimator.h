@@ -13,17 +13,12 @@ public:
 
     ~RePiBone() = default;
 
-    void SetFinalTransform(
-        const RePiMatrix& FinalTransform);
-
     void SetTransform(
         const RePiMatrix& Transform);
 
     void SetOffset(
         const RePiMatrix& Offset);
 
-    RePiMatrix GetFinalTransform() const;
-
     RePiMatrix GetTransform() const;
 
     RePiMatrix GetOffset() const;
@@ -36,8 +31,6 @@ public:
     std::vector<std::weak_ptr<RePiBone>> mChildren;
 
 private:
-    RePiMatrix mFinalTransform;
-
     RePiMatrix mTransform;
 
     RePiMatrix mOffset;
@@ -67,35 +60,43 @@ public:
 
     uint32_t GetBoneCount() const;
 
+    // Flattens the tree under the root into slots where every parent comes before its children
+    void BuildHierarchy();
+
+    uint32_t GetHierarchySize() const;
+
+    // Bone index held by each slot
+    const std::vector<uint32_t>& GetHierarchyBones() const;
+
+    // Parent slot of each slot, -1 for the root
+    const std::vector<int32_t>& GetHierarchyParents() const;
+
+    const std::vector<RePiMatrix>& GetHierarchyTransforms() const;
+
+    const std::vector<RePiMatrix>& GetHierarchyOffsets() const;
+
 private:
     std::map<std::string, std::shared_ptr<RePiBone>> mBoneMap;
 
     std::weak_ptr<RePiBone> mRootBone;
-};
-
-class RePiKeyFrameData
-{
-public:
-    friend class RePiChannel;
 
-    RePiKeyFrameData(
-        const float Time = 0.f,
-        const RePiFloat3& Position = RePiFloat3::ZERO,
-        const RePiFloat3& Scale = RePiFloat3::ZERO,
-        const RePiQuaternion& Rotation = RePiQuaternion::IDENTITY);
+    std::vector<uint32_t> mHierarchyBones;
 
-    ~RePiKeyFrameData() = default;
+    std::vector<int32_t> mHierarchyParents;
 
-private:
-    RePiFloat3 mPosition;
+    std::vector<RePiMatrix> mHierarchyTransforms;
 
-    RePiFloat3 mScale;
+    std::vector<RePiMatrix> mHierarchyOffsets;
+};
 
-    RePiQuaternion mRotation;
+// Where an animator last sampled each track of a channel, keys only move forward during playback
+struct RePiChannelCursor
+{
+    uint32_t Scale = 0;
 
-    std::weak_ptr<RePiKeyFrameData> mNext;
+    uint32_t Rotation = 0;
 
-    float mTime;
+    uint32_t Position = 0;
 };
 
 class RePiChannel
@@ -104,7 +105,7 @@ public:
     RePiChannel(
         const uint32_t BoneIndex = 0);
 
-    ~RePiChannel();
+    ~RePiChannel() = default;
 
     void AddScaleKey(
         const RePiFloat3& Scale,
@@ -120,27 +121,50 @@ public:
 
     uint32_t GetBoneIndex() const;
 
+    // Sampling never writes to the channel, any number of animators can share it across threads
+    RePiMatrix GetTransformByTime(
+        const float CurrentCycleTime) const;
+
+    // Same sample, starting the key search where Cursor was left and moving it along
     RePiMatrix GetTransformByTime(
-        const float CurrentCycleTime);
+        const float CurrentCycleTime,
+        RePiChannelCursor& Cursor) const;
 
 private:
-    void AddKeyFrameData(
-        std::vector<std::shared_ptr<RePiKeyFrameData>>& KeyFrames,
+    // Last key at or before Time, times before the first key clamp to it
+    static uint32_t FindKeyIndex(
+        const std::vector<float>& KeyTimes,
+        const float Time = 0.f);
+
+    // FindKeyIndex starting at Hint, steps forward a few keys and only binary searches on a seek or a loop
+    static uint32_t AdvanceKeyIndex(
+        const std::vector<float>& KeyTimes,
         const float Time = 0.f,
-        const RePiFloat3& Position = RePiFloat3::ZERO,
-        const RePiFloat3& Scale = RePiFloat3::ZERO,
-        const RePiQuaternion& Rotation = RePiQuaternion::IDENTITY);
+        const uint32_t Hint = 0);
+
+    RePiMatrix ComposeTransform(
+        const float Time,
+        const RePiChannelCursor& Keys) const;
 
-    std::weak_ptr<RePiKeyFrameData> GetKeyFrameDataByTime(
-        const float CurrentCicleTime,
-        const std::vector<std::shared_ptr<RePiKeyFrameData>>& KeyFrames) const;
+    // Blend factor from key Index to the next one, 0 on the last key
+    static float GetKeyInterpolation(
+        const std::vector<float>& KeyTimes,
+        const uint32_t Index = 0,
+        const float Time = 0.f);
 
 private:
-    std::vector<std::shared_ptr<RePiKeyFrameData>> mScale;
+    // Every track is a pair of parallel arrays sorted by time
+    std::vector<float> mScaleTimes;
 
-    std::vector<std::shared_ptr<RePiKeyFrameData>> mRotation;
+    std::vector<RePiFloat3> mScaleKeys;
 
-    std::vector<std::shared_ptr<RePiKeyFrameData>> mPosition;
+    std::vector<float> mRotationTimes;
+
+    std::vector<RePiQuaternion> mRotationKeys;
+
+    std::vector<float> mPositionTimes;
+
+    std::vector<RePiFloat3> mPositionKeys;
 
     int32_t mBoneIndex;
 };
@@ -159,11 +183,18 @@ public:
     std::weak_ptr<RePiChannel> GetChannel(
         const uint32_t BoneIndex) const;
 
+    // No weak_ptr lock, for the pose loop that already holds the animation
+    const RePiChannel* GetChannelByBone(
+        const uint32_t BoneIndex) const;
+
     float GetCycleTime() const;
 
 private:
     std::map<std::string, std::shared_ptr<RePiChannel>> mChannelMap;
 
+    // Same channels indexed by bone, GetChannel(BoneIndex) runs per bone every frame
+    std::vector<std::shared_ptr<RePiChannel>> mChannelList;
+
     float mCycleTime;
 };
 
@@ -211,11 +242,15 @@ public:
     void Update(
         const float Tick);
 
+    // One job per animator, each writes only its own pose so they run in parallel
+    static void UpdateAll(
+        const std::vector<std::weak_ptr<RePiAnimator>>& Animators,
+        const float Tick);
+
     RePiMatrix mJoinTransform[MaxBoneCapacity];
 private:
-    void UpdateBoneTransform(
-        const std::weak_ptr<RePiBone>& Bone,
-        const RePiMatrix& Transform);
+    // One pass over the skeleton's flat hierarchy, parents resolve before their children
+    void UpdatePose();
 
 private:
     std::map<std::string, std::weak_ptr<RePiAnimation>> mAnimationMap;
@@ -228,6 +263,12 @@ private:
 
     RePiMatrix mBoneTransform[MaxBoneCapacity];
 
+    // Per bone, animations are shared so the cursors live with the animator playing them
+    RePiChannelCursor mChannelCursor[MaxBoneCapacity];
+
+    // Model space pose by hierarchy slot
+    std::vector<RePiMatrix> mModelTransform;
+
     RePiMatrix mTransform;
 
     float mCurrentCycleTime;
@@ -29,6 +29,28 @@
 #include <vector>
 #include <functional>
 #include <utility>
+#include <bit>
+#include <new>
+
+// x64 only guarantees SSE2, MSVC reports the newer sets through __AVX__ (/arch:AVX and up)
+#if defined(__AVX__) || defined(__SSSE3__)
+#define REPI_SIMD_SSSE3 1
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX__) || defined(__SSE4_1__)
+#define REPI_SIMD_SSE41 1
+#endif
+
+#if defined(__AVX2__)
+#define REPI_SIMD_AVX2 1
+#endif
+
+// Define to check every clustered lighting result against a loop over all lights, slow
+//#define REPI_VALIDATE_LIGHT_GRID 1
+
+// Define to log the PSNR of every texture compressed at load time
+//#define REPI_MEASURE_TEXTURE_COMPRESSION 1
 
 enum RePiVertexTopology
 {
@@ -53,6 +75,15 @@ enum RePiTextureFormat
     eB8G8R8A8_UNORM,
     eR32G32B32A32_FLOAT,
     eR16G16B16A16_FLOAT,
+    eBC1_UNORM,
+    eBC2_UNORM,
+    eBC3_UNORM,
+    eR8G8B8_UNORM,
+    eR8G8B8A8_UNORM_SRGB,
+    eR8G8B8_UNORM_SRGB,
+    eBC1_UNORM_SRGB,
+    eBC2_UNORM_SRGB,
+    eBC3_UNORM_SRGB,
 };
 
 enum RePiFillMode
@@ -89,7 +120,17 @@ enum RePiComparisonFunction
 enum RePiSampleFilter
 {
     eFILTER_POINT = 0,
-    eFILTER_LINEAR
+    eFILTER_LINEAR,
+    eFILTER_ANISOTROPIC
+};
+
+// Coarse shading sizes, width x height in pixels
+enum RePiShadingRate
+{
+    eRATE_1X1 = 0,
+    eRATE_1X2,
+    eRATE_2X2,
+    eRATE_4X4
 };
 
 enum RePiTextureAdressMode
@@ -156,6 +197,54 @@ typedef geEngineSDK::PerspectiveMatrix RePiPerspectiveMatrix;
 typedef geEngineSDK::Math RePiMath;
 typedef geEngineSDK::Color RePiColor;
 
+// Pixel storage starts on a cache line, buffers of 2MB or more start on a huge page boundary
+template<class T>
+struct RePiAlignedAllocator
+{
+    using value_type = T;
+
+    static const size_t CacheLineAlignment = 64;
+    static const size_t HugePageAlignment = 2 * 1024 * 1024;
+
+    RePiAlignedAllocator() = default;
+
+    template<class U>
+    RePiAlignedAllocator(const RePiAlignedAllocator<U>&) {}
+
+    T* allocate(
+        const size_t Count)
+    {
+        return static_cast<T*>(::operator new(Count * sizeof(T), std::align_val_t(GetAlignment(Count))));
+    }
+
+    void deallocate(
+        T* Pointer,
+        const size_t Count)
+    {
+        ::operator delete(Pointer, std::align_val_t(GetAlignment(Count)));
+    }
+
+    static size_t GetAlignment(
+        const size_t Count)
+    {
+        return Count * sizeof(T) >= HugePageAlignment ? HugePageAlignment : CacheLineAlignment;
+    }
+
+    template<class U>
+    bool operator==(const RePiAlignedAllocator<U>&) const
+    {
+        return true;
+    }
+
+    template<class U>
+    bool operator!=(const RePiAlignedAllocator<U>&) const
+    {
+        return false;
+    }
+};
+
+typedef std::vector<uint8_t, RePiAlignedAllocator<uint8_t>> RePiPixelBuffer;
+
 #if defined(VK)
 inline std::string VkResultToString(VkResult Result)
 {
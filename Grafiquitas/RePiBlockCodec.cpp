@@ -0,0 +1,369 @@
+#include "RePiBlockCodec.h"
+
+#include <atomic>
+
+static const uint32_t BLOCK_CACHE_SIZE = 64;
+
+struct DecodedBlock
+{
+    uint64_t Tag;
+    uint8_t Texels[RePiBlockCodec::BlockTexels * 4];
+};
+
+// Tag 0 is never produced because cache keys start at 1
+static thread_local DecodedBlock g_BlockCache[BLOCK_CACHE_SIZE] = {};
+
+static void Expand565(
+    const uint16_t Color,
+    uint8_t* Out)
+{
+    const uint32_t r = (Color >> 11) & 0x1F;
+    const uint32_t g = (Color >> 5) & 0x3F;
+    const uint32_t b = Color & 0x1F;
+
+    Out[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+    Out[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+    Out[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+    Out[3] = 255;
+}
+
+static const uint16_t Pack565(
+    const uint8_t* Color)
+{
+    return static_cast<uint16_t>(((Color[0] >> 3) << 11) | ((Color[1] >> 2) << 5) | (Color[2] >> 3));
+}
+
+bool RePiBlockCodec::IsBlockCompressed(
+    const RePiTextureFormat Format)
+{
+    return GetBlockBytes(Format) != 0;
+}
+
+uint32_t RePiBlockCodec::GetBlockBytes(
+    const RePiTextureFormat Format)
+{
+    switch (Format)
+    {
+    case eBC1_UNORM:
+    case eBC1_UNORM_SRGB:
+        return 8;
+    case eBC2_UNORM:
+    case eBC2_UNORM_SRGB:
+    case eBC3_UNORM:
+    case eBC3_UNORM_SRGB:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+uint32_t RePiBlockCodec::GetBlocksWide(
+    const int32_t Width)
+{
+    return static_cast<uint32_t>(Width + BlockDim - 1) / BlockDim;
+}
+
+uint32_t RePiBlockCodec::NewCacheKey()
+{
+    static std::atomic<uint32_t> NextKey(1u);
+
+    uint32_t Key = NextKey.fetch_add(1u);
+    if (Key == 0u)
+    {
+        Key = NextKey.fetch_add(1u);
+    }
+
+    return Key;
+}
+
+void RePiBlockCodec::DecodeBlock(
+    const RePiTextureFormat Format,
+    const uint8_t* Block,
+    uint8_t* Texels)
+{
+    switch (Format)
+    {
+    case eBC1_UNORM:
+    case eBC1_UNORM_SRGB:
+        DecodeColorBlock(Block, Texels, true);
+        break;
+    case eBC2_UNORM:
+    case eBC2_UNORM_SRGB:
+        DecodeColorBlock(Block + 8, Texels, false);
+        DecodeExplicitAlpha(Block, Texels);
+        break;
+    case eBC3_UNORM:
+    case eBC3_UNORM_SRGB:
+        DecodeColorBlock(Block + 8, Texels, false);
+        DecodeInterpolatedAlpha(Block, Texels);
+        break;
+    default:
+        memset(Texels, 0, BlockTexels * 4);
+        break;
+    }
+}
+
+void RePiBlockCodec::EncodeBlock(
+    const RePiTextureFormat Format,
+    const uint8_t* Texels,
+    uint8_t* Block)
+{
+    switch (Format)
+    {
+    case eBC1_UNORM:
+    case eBC1_UNORM_SRGB:
+        EncodeColorBlock(Texels, Block);
+        break;
+    case eBC3_UNORM:
+    case eBC3_UNORM_SRGB:
+        EncodeInterpolatedAlpha(Texels, Block);
+        EncodeColorBlock(Texels, Block + 8);
+        break;
+    default:
+        break;
+    }
+}
+
+const uint8_t* RePiBlockCodec::FetchBlock(
+    const RePiTextureFormat Format,
+    const uint32_t CacheKey,
+    const uint32_t BlockIndex,
+    const uint8_t* Block)
+{
+    const uint64_t Tag = (static_cast<uint64_t>(CacheKey) << 32) | BlockIndex;
+    const uint32_t Slot = (BlockIndex ^ (CacheKey * 0x9E3779B1u)) & (BLOCK_CACHE_SIZE - 1);
+
+    DecodedBlock& Entry = g_BlockCache[Slot];
+    if (Entry.Tag != Tag)
+    {
+        DecodeBlock(Format, Block, Entry.Texels);
+        Entry.Tag = Tag;
+    }
+
+    return Entry.Texels;
+}
+
+void RePiBlockCodec::DecodeColorBlock(
+    const uint8_t* Block,
+    uint8_t* Texels,
+    const bool AllowTransparent)
+{
+    const uint16_t c0 = static_cast<uint16_t>(Block[0] | (Block[1] << 8));
+    const uint16_t c1 = static_cast<uint16_t>(Block[2] | (Block[3] << 8));
+
+    uint8_t Palette[4][4];
+    Expand565(c0, Palette[0]);
+    Expand565(c1, Palette[1]);
+
+    if (!AllowTransparent || c0 > c1)
+    {
+        for (int32_t c = 0; c < 3; ++c)
+        {
+            Palette[2][c] = static_cast<uint8_t>((2 * Palette[0][c] + Palette[1][c]) / 3);
+            Palette[3][c] = static_cast<uint8_t>((Palette[0][c] + 2 * Palette[1][c]) / 3);
+        }
+        Palette[2][3] = 255;
+        Palette[3][3] = 255;
+    }
+    else
+    {
+        for (int32_t c = 0; c < 3; ++c)
+        {
+            Palette[2][c] = static_cast<uint8_t>((Palette[0][c] + Palette[1][c]) / 2);
+        }
+        Palette[2][3] = 255;
+        memset(Palette[3], 0, 4);
+    }
+
+    const uint32_t Indices = Block[4] | (Block[5] << 8) | (Block[6] << 16) | (static_cast<uint32_t>(Block[7]) << 24);
+
+    for (uint32_t i = 0; i < BlockTexels; ++i)
+    {
+        memcpy(&Texels[i * 4], Palette[(Indices >> (2 * i)) & 3], 4);
+    }
+}
+
+void RePiBlockCodec::DecodeExplicitAlpha(
+    const uint8_t* Block,
+    uint8_t* Texels)
+{
+    for (uint32_t i = 0; i < BlockTexels; ++i)
+    {
+        const uint32_t Alpha = (Block[i >> 1] >> ((i & 1) * 4)) & 0xF;
+
+        Texels[i * 4 + 3] = static_cast<uint8_t>(Alpha * 17);
+    }
+}
+
+void RePiBlockCodec::DecodeInterpolatedAlpha(
+    const uint8_t* Block,
+    uint8_t* Texels)
+{
+    uint32_t Palette[8];
+    Palette[0] = Block[0];
+    Palette[1] = Block[1];
+
+    if (Palette[0] > Palette[1])
+    {
+        for (uint32_t i = 1; i < 7; ++i)
+        {
+            Palette[i + 1] = ((7 - i) * Palette[0] + i * Palette[1]) / 7;
+        }
+    }
+    else
+    {
+        for (uint32_t i = 1; i < 5; ++i)
+        {
+            Palette[i + 1] = ((5 - i) * Palette[0] + i * Palette[1]) / 5;
+        }
+        Palette[6] = 0;
+        Palette[7] = 255;
+    }
+
+    uint64_t Indices = 0;
+    for (int32_t i = 0; i < 6; ++i)
+    {
+        Indices |= static_cast<uint64_t>(Block[2 + i]) << (8 * i);
+    }
+
+    for (uint32_t i = 0; i < BlockTexels; ++i)
+    {
+        Texels[i * 4 + 3] = static_cast<uint8_t>(Palette[(Indices >> (3 * i)) & 7]);
+    }
+}
+
+void RePiBlockCodec::EncodeColorBlock(
+    const uint8_t* Texels,
+    uint8_t* Block)
+{
+    uint8_t Min[3] = { 255, 255, 255 };
+    uint8_t Max[3] = { 0, 0, 0 };
+
+    for (uint32_t i = 0; i < BlockTexels; ++i)
+    {
+        for (int32_t c = 0; c < 3; ++c)
+        {
+            Min[c] = RePiMath::min(Min[c], Texels[i * 4 + c]);
+            Max[c] = RePiMath::max(Max[c], Texels[i * 4 + c]);
+        }
+    }
+
+    // Pull the bounding box in by 1/16 of its size, the endpoints are rarely hit exactly
+    for (int32_t c = 0; c < 3; ++c)
+    {
+        const int32_t Inset = (Max[c] - Min[c]) >> 4;
+
+        Min[c] = static_cast<uint8_t>(RePiMath::min(255, Min[c] + Inset));
+        Max[c] = static_cast<uint8_t>(RePiMath::max(0, Max[c] - Inset));
+    }
+
+    uint16_t c0 = Pack565(Max);
+    uint16_t c1 = Pack565(Min);
+    if (c0 < c1)
+    {
+        std::swap(c0, c1);
+    }
+
+    Block[0] = static_cast<uint8_t>(c0 & 0xFF);
+    Block[1] = static_cast<uint8_t>(c0 >> 8);
+    Block[2] = static_cast<uint8_t>(c1 & 0xFF);
+    Block[3] = static_cast<uint8_t>(c1 >> 8);
+
+    uint32_t Indices = 0;
+
+    // A flat block keeps every index at zero, there is only one color to choose from
+    if (c0 != c1)
+    {
+        uint8_t Palette[4][4];
+        Expand565(c0, Palette[0]);
+        Expand565(c1, Palette[1]);
+        for (int32_t c = 0; c < 3; ++c)
+        {
+            Palette[2][c] = static_cast<uint8_t>((2 * Palette[0][c] + Palette[1][c]) / 3);
+            Palette[3][c] = static_cast<uint8_t>((Palette[0][c] + 2 * Palette[1][c]) / 3);
+        }
+
+        for (uint32_t i = 0; i < BlockTexels; ++i)
+        {
+            uint32_t BestIndex = 0;
+            int32_t BestDistance = INT32_MAX;
+
+            for (uint32_t p = 0; p < 4; ++p)
+            {
+                int32_t Distance = 0;
+                for (int32_t c = 0; c < 3; ++c)
+                {
+                    const int32_t Delta = Texels[i * 4 + c] - Palette[p][c];
+                    Distance += Delta * Delta;
+                }
+
+                if (Distance < BestDistance)
+                {
+                    BestDistance = Distance;
+                    BestIndex = p;
+                }
+            }
+
+            Indices |= BestIndex << (2 * i);
+        }
+    }
+
+    Block[4] = static_cast<uint8_t>(Indices & 0xFF);
+    Block[5] = static_cast<uint8_t>((Indices >> 8) & 0xFF);
+    Block[6] = static_cast<uint8_t>((Indices >> 16) & 0xFF);
+    Block[7] = static_cast<uint8_t>(Indices >> 24);
+}
+
+void RePiBlockCodec::EncodeInterpolatedAlpha(
+    const uint8_t* Texels,
+    uint8_t* Block)
+{
+    uint32_t Min = 255;
+    uint32_t Max = 0;
+
+    for (uint32_t i = 0; i < BlockTexels; ++i)
+    {
+        Min = RePiMath::min(Min, static_cast<uint32_t>(Texels[i * 4 + 3]));
+        Max = RePiMath::max(Max, static_cast<uint32_t>(Texels[i * 4 + 3]));
+    }
+
+    // Always use the eight value mode, a0 > a1 unless the block is flat
+    Block[0] = static_cast<uint8_t>(Max);
+    Block[1] = static_cast<uint8_t>(Min);
+
+    uint32_t Palette[8];
+    Palette[0] = Max;
+    Palette[1] = Min;
+    for (uint32_t i = 1; i < 7; ++i)
+    {
+        Palette[i + 1] = ((7 - i) * Max + i * Min) / 7;
+    }
+
+    uint64_t Indices = 0;
+    if (Max != Min)
+    {
+        for (uint32_t i = 0; i < BlockTexels; ++i)
+        {
+            const int32_t Alpha = Texels[i * 4 + 3];
+            uint64_t BestIndex = 0;
+            int32_t BestDistance = INT32_MAX;
+
+            for (uint32_t p = 0; p < 8; ++p)
+            {
+                const int32_t Distance = std::abs(Alpha - static_cast<int32_t>(Palette[p]));
+                if (Distance < BestDistance)
+                {
+                    BestDistance = Distance;
+                    BestIndex = p;
+                }
+            }
+
+            Indices |= BestIndex << (3 * i);
+        }
+    }
+
+    for (int32_t i = 0; i < 6; ++i)
+    {
+        Block[2 + i] = static_cast<uint8_t>((Indices >> (8 * i)) & 0xFF);
+    }
+}
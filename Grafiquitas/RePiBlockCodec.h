@@ -0,0 +1,63 @@
+#pragma once
+
+#include "RePiBase.h"
+
+class RePiBlockCodec
+{
+public:
+    static const uint32_t BlockDim = 4;
+
+    static const uint32_t BlockTexels = BlockDim * BlockDim;
+
+    static bool IsBlockCompressed(
+        const RePiTextureFormat Format = RePiTextureFormat::eUNKNOWN);
+
+    static uint32_t GetBlockBytes(
+        const RePiTextureFormat Format = RePiTextureFormat::eUNKNOWN);
+
+    static uint32_t GetBlocksWide(
+        const int32_t Width = 0);
+
+    static uint32_t NewCacheKey();
+
+    // Decodes a block into 16 texels of 4 bytes, stored in the same byte order as uncompressed images
+    static void DecodeBlock(
+        const RePiTextureFormat Format,
+        const uint8_t* Block,
+        uint8_t* Texels);
+
+    // Encodes 16 texels of 4 bytes, BC1 is always written in its opaque four color mode
+    static void EncodeBlock(
+        const RePiTextureFormat Format,
+        const uint8_t* Texels,
+        uint8_t* Block);
+
+    // Returns the decoded block through the calling thread's direct-mapped block cache
+    static const uint8_t* FetchBlock(
+        const RePiTextureFormat Format,
+        const uint32_t CacheKey,
+        const uint32_t BlockIndex,
+        const uint8_t* Block);
+
+private:
+    static void DecodeColorBlock(
+        const uint8_t* Block,
+        uint8_t* Texels,
+        const bool AllowTransparent);
+
+    static void DecodeExplicitAlpha(
+        const uint8_t* Block,
+        uint8_t* Texels);
+
+    static void DecodeInterpolatedAlpha(
+        const uint8_t* Block,
+        uint8_t* Texels);
+
+    static void EncodeColorBlock(
+        const uint8_t* Texels,
+        uint8_t* Block);
+
+    static void EncodeInterpolatedAlpha(
+        const uint8_t* Texels,
+        uint8_t* Block);
+};
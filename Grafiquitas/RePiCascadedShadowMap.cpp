@@ -0,0 +1,267 @@
+#include "RePiCascadedShadowMap.h"
+
+#include "RePi3DModel.h"
+#include "RePiTexture.h"
+
+namespace
+{
+    // FNV-1a, enough to notice a cascade's inputs changed
+    uint64_t HashBytes(
+        uint64_t Hash,
+        const void* Data,
+        const size_t Size)
+    {
+        const uint8_t* Bytes = static_cast<const uint8_t*>(Data);
+        for (size_t i = 0; i < Size; ++i)
+        {
+            Hash = (Hash ^ Bytes[i]) * 1099511628211ull;
+        }
+
+        return Hash;
+    }
+}
+
+RePiCascadedShadowMap::RePiCascade::RePiCascade(
+    const int32_t Resolution) :
+    Map(Resolution),
+    Constants(std::make_shared<GeometryConstantBuffer>())
+{
+    Geometry.BindConstantBuffer(Constants);
+    Geometry.BindVertexShader(&RePiCascadedShadowMap::DepthVertexShader);
+
+    Rasterizer.BindTriangleList(Geometry.GetTriangleList());
+    Rasterizer.BindDepth(Map.GetDepth());
+}
+
+RePiCascadedShadowMap::RePiCascadedShadowMap(
+    const uint32_t CascadeCount,
+    const int32_t Resolution,
+    const float ShadowDistance,
+    const float SplitLambda,
+    const float CasterExtent) :
+    mResolution(RePiMath::max(Resolution, 2)),
+    mShadowDistance(ShadowDistance),
+    mSplitLambda(RePiMath::clamp(SplitLambda, 0.f, 1.f)),
+    mCasterExtent(CasterExtent),
+    mLightRotation(RePiMatrix::IDENTITY),
+    mInverseLightRotation(RePiMatrix::IDENTITY),
+    mRenderedCount(0)
+{
+    for (uint32_t i = 0; i < RePiMath::max(CascadeCount, 1u); ++i)
+    {
+        mCascades.push_back(std::make_unique<RePiCascade>(mResolution));
+    }
+
+    SetLight(RePiFloat3(0.f, -1.f, 0.f));
+}
+
+void RePiCascadedShadowMap::SetLight(
+    const RePiFloat3& Direction)
+{
+    mDirection = Direction.sizeSquared() > 0.f ? Direction.getSafeNormal() : RePiFloat3(0.f, -1.f, 0.f);
+
+    mLightRotation = RePiLookAtMatrix(RePiFloat3::ZERO, mDirection, RePiShadowMap::GetLightUp(mDirection));
+    mInverseLightRotation = mLightRotation.inverseFast();
+}
+
+void RePiCascadedShadowMap::Update(
+    const RePiMatrix& View,
+    const RePiMatrix& Projection,
+    const float NearZ,
+    const RePiInt2& ScreenSize)
+{
+    const RePiMatrix ViewProjection = View * Projection;
+    const RePiMatrix InverseViewProjection = ViewProjection.inverseFast();
+
+    const float Near = RePiMath::max(NearZ, 0.001f);
+    const float Far = RePiMath::max(mShadowDistance, Near * 2.f);
+
+    auto ToNdcDepth = [&Projection](const float Distance)
+    {
+        const RePiFloat4 Clip = Projection.transformVector4(RePiFloat4(0.f, 0.f, Distance, 1.f));
+        return Clip.z / Clip.w;
+    };
+
+    float SliceNear = Near;
+    for (size_t i = 0; i < mCascades.size(); ++i)
+    {
+        const float t = float(i + 1) / float(mCascades.size());
+        const float Uniform = Near + (Far - Near) * t;
+        const float Logarithmic = Near * std::pow(Far / Near, t);
+        const float SliceFar = Uniform + (Logarithmic - Uniform) * mSplitLambda;
+
+        RePiFloat3 Corners[8];
+        RePiFloat3 Center = RePiFloat3::ZERO;
+        for (int32_t Corner = 0; Corner < 8; ++Corner)
+        {
+            const RePiFloat4 World = InverseViewProjection.transformVector4(RePiFloat4(
+                Corner & 1 ? 1.f : -1.f,
+                Corner & 2 ? 1.f : -1.f,
+                ToNdcDepth(Corner & 4 ? SliceFar : SliceNear),
+                1.f));
+
+            Corners[Corner] = RePiFloat3(World.x, World.y, World.z) / World.w;
+            Center += Corners[Corner] / 8.f;
+        }
+
+        // The slice is rigid, so the radius only changes with the split, rounding keeps float noise out of it
+        float Radius = 0.f;
+        for (const RePiFloat3& Corner : Corners)
+        {
+            Radius = RePiMath::max(Radius, (Corner - Center).size());
+        }
+        Radius = std::ceil(Radius);
+
+        // Whole texel steps stop the map from crawling while the camera moves
+        const float TexelSize = 2.f * Radius / mResolution;
+        const RePiFloat4 LightCenter = mLightRotation.transformVector4(RePiFloat4(Center, 1.f));
+        const RePiFloat4 Snapped(
+            std::floor(LightCenter.x / TexelSize) * TexelSize,
+            std::floor(LightCenter.y / TexelSize) * TexelSize,
+            LightCenter.z,
+            1.f);
+        const RePiFloat4 SnappedCenter = mInverseLightRotation.transformVector4(Snapped);
+
+        RePiShadowMap& Map = mCascades[i]->Map;
+        Map.SetLight(mDirection, RePiFloat3(SnappedCenter.x, SnappedCenter.y, SnappedCenter.z), Radius, mCasterExtent);
+        Map.BindScreen(ViewProjection, ScreenSize);
+
+        SliceNear = SliceFar;
+    }
+}
+
+RePiVertex RePiCascadedShadowMap::DepthVertexShader(
+    const RePiVertex& Input,
+    const GeometryConstantBuffer& Buffer)
+{
+    RePiFloat4 Position = Input.Position;
+
+    // Blending the four skinned positions is cheaper than blending the four matrices
+    if (Input.BoneWeight[0] > 0)
+    {
+        RePiFloat4 Skinned = RePiFloat4::ZERO;
+        for (int32_t i = 0; i < 4; ++i)
+        {
+            Skinned = Skinned + Buffer.Bones[Input.BoneIndex[i]].transformVector4(Position) * Input.BoneWeight[i];
+        }
+        Position = Skinned;
+    }
+
+    Position = Buffer.World.transformVector4(Position);
+    Position = Buffer.View.transformVector4(Position);
+
+    RePiVertex Output;
+    Output.Position = Buffer.Projection.transformVector4(Position);
+
+    return Output;
+}
+
+void RePiCascadedShadowMap::Render(
+    const std::vector<RePiShadowCaster>& Casters,
+    const RasteriserSettings& Settings)
+{
+    RasteriserSettings DepthSettings = Settings;
+    DepthSettings.wireframe = false;
+    DepthSettings.depthEnable = true;
+    DepthSettings.depthFunc = RePiComparisonFunction::eLESS;
+
+    int32_t Rendered = 0;
+
+    // One cascade per worker, the rasterizer's own loops stay serial inside them
+#pragma omp parallel for schedule(dynamic) reduction(+:Rendered)
+    for (int32_t i = 0; i < static_cast<int32_t>(mCascades.size()); ++i)
+    {
+        RePiCascade& Cascade = *mCascades[i];
+
+        const RePiMatrix LightView = Cascade.Map.GetView();
+        const RePiMatrix LightProjection = Cascade.Map.GetProjection();
+
+        uint64_t Signature = 14695981039346656037ull;
+        Signature = HashBytes(Signature, &LightView, sizeof(RePiMatrix));
+        Signature = HashBytes(Signature, &LightProjection, sizeof(RePiMatrix));
+
+        Cascade.DrawList.clear();
+        for (uint32_t Index = 0; Index < Casters.size(); ++Index)
+        {
+            const RePiShadowCaster& Caster = Casters[Index];
+            if (Caster.Mesh.expired() || !Cascade.Map.Intersects(Caster.Center, Caster.Radius))
+            {
+                continue;
+            }
+
+            Cascade.DrawList.push_back(Index);
+
+            const void* Mesh = Caster.Mesh.lock().get();
+            Signature = HashBytes(Signature, &Mesh, sizeof(Mesh));
+            Signature = HashBytes(Signature, &Caster.World, sizeof(RePiMatrix));
+            if (nullptr != Caster.Bones)
+            {
+                Signature = HashBytes(Signature, Caster.Bones, sizeof(RePiMatrix) * MaxBoneCapacity);
+            }
+        }
+
+        if (Cascade.Valid && Signature == Cascade.Signature)
+        {
+            continue;
+        }
+
+        Cascade.Signature = Signature;
+        Cascade.Valid = true;
+        ++Rendered;
+
+        Cascade.Map.Clear();
+        Cascade.Constants->View = LightView;
+        Cascade.Constants->Projection = LightProjection;
+
+        Cascade.Rasterizer.BindRasteriserSettings(DepthSettings);
+        Cascade.Rasterizer.BindPixelShader(PixelShader());
+
+        for (const uint32_t Index : Cascade.DrawList)
+        {
+            const RePiShadowCaster& Caster = Casters[Index];
+            auto pMesh = Caster.Mesh.lock();
+            if (nullptr == pMesh)
+            {
+                continue;
+            }
+
+            Cascade.Constants->World = Caster.World;
+            if (nullptr != Caster.Bones)
+            {
+                memcpy(Cascade.Constants->Bones, Caster.Bones, sizeof(RePiMatrix) * MaxBoneCapacity);
+            }
+
+            Cascade.Geometry.BindIndexBuffer(pMesh->getIndexBuffer());
+            Cascade.Geometry.BindVertexBuffer(pMesh->getVertexBuffer());
+            Cascade.Geometry.BindTopology(pMesh->getTopology());
+
+            Cascade.Geometry.Execute();
+            Cascade.Rasterizer.Execute();
+        }
+    }
+
+    mRenderedCount = static_cast<uint32_t>(Rendered);
+}
+
+float RePiCascadedShadowMap::ComputeShadow(
+    const RePiVertex& V) const
+{
+    for (const auto& Cascade : mCascades)
+    {
+        const RePiFloat4 ShadowClip = Cascade->Map.GetShadowClip(V);
+        if (Cascade->Map.Covers(ShadowClip))
+        {
+            return Cascade->Map.SampleShadow(ShadowClip);
+        }
+    }
+
+    return 1.f;
+}
+
+void RePiCascadedShadowMap::Invalidate()
+{
+    for (auto& Cascade : mCascades)
+    {
+        Cascade->Valid = false;
+    }
+}
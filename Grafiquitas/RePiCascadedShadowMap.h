@@ -0,0 +1,116 @@
+#pragma once
+
+#include "RePiBase.h"
+#include "RePiGeometryStage.h"
+#include "RePiRasterizerStage.h"
+#include "RePiShadowMap.h"
+
+class RePiMesh;
+
+// One mesh as the shadow passes see it, the sphere is what cascades cull against
+struct RePiShadowCaster
+{
+    std::weak_ptr<RePiMesh> Mesh;
+    RePiMatrix World = RePiMatrix::IDENTITY;
+
+    // MaxBoneCapacity matrices, null when the mesh isn't skinned
+    const RePiMatrix* Bones = nullptr;
+
+    RePiFloat3 Center = RePiFloat3::ZERO;
+    float Radius = 0.f;
+};
+
+// Directional light shadows split over slices of the camera frustum, each slice gets its own map
+class RePiCascadedShadowMap
+{
+public:
+    RePiCascadedShadowMap(
+        const uint32_t CascadeCount = 4,
+        const int32_t Resolution = 1024,
+        const float ShadowDistance = 3000.f,
+        const float SplitLambda = 0.75f,
+        const float CasterExtent = 1000.f);
+
+    ~RePiCascadedShadowMap() = default;
+
+    void SetLight(
+        const RePiFloat3& Direction);
+
+    // Fits every cascade around its slice of the camera frustum, splits blend logarithmic and uniform by SplitLambda
+    void Update(
+        const RePiMatrix& View,
+        const RePiMatrix& Projection,
+        const float NearZ,
+        const RePiInt2& ScreenSize);
+
+    // Culls the casters per cascade and re-renders, in parallel, only the cascades whose light box or casters changed
+    // Casters go through DepthVertexShader, only their skinned positions are transformed
+    void Render(
+        const std::vector<RePiShadowCaster>& Casters,
+        const RasteriserSettings& Settings = RasteriserSettings());
+
+    // 1 lit, 0 shadowed, from the first cascade that covers the pixel
+    float ComputeShadow(
+        const RePiVertex& V) const;
+
+    RePiFloat3 GetDirection() const
+    {
+        return mDirection;
+    }
+
+    uint32_t GetCascadeCount() const
+    {
+        return static_cast<uint32_t>(mCascades.size());
+    }
+
+    // Cascades the last Render actually drew
+    uint32_t GetRenderedCount() const
+    {
+        return mRenderedCount;
+    }
+
+    void Invalidate();
+
+private:
+    static RePiVertex DepthVertexShader(
+        const RePiVertex& Input,
+        const GeometryConstantBuffer& Buffer);
+
+    struct RePiCascade
+    {
+        RePiShadowMap Map;
+
+        // Each cascade has its own pipeline so they can run side by side
+        RePiGeometryStage Geometry;
+        RePiRasterizerStage Rasterizer;
+        std::shared_ptr<GeometryConstantBuffer> Constants;
+
+        std::vector<uint32_t> DrawList;
+
+        uint64_t Signature = 0;
+        bool Valid = false;
+
+        RePiCascade(
+            const int32_t Resolution);
+    };
+
+private:
+    std::vector<std::unique_ptr<RePiCascade>> mCascades;
+
+    int32_t mResolution;
+
+    float mShadowDistance;
+
+    float mSplitLambda;
+
+    float mCasterExtent;
+
+    RePiFloat3 mDirection;
+
+    // Light orientation without translation, centers are snapped to whole texels in it
+    RePiMatrix mLightRotation;
+
+    RePiMatrix mInverseLightRotation;
+
+    uint32_t mRenderedCount;
+};
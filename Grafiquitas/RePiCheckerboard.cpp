@@ -0,0 +1,121 @@
+#include "RePiCheckerboard.h"
+
+RePiCheckerboard::RePiCheckerboard() :
+    mSize(RePiInt2::ZERO),
+    mParity(0)
+{
+}
+
+void RePiCheckerboard::BeginFrame(
+    const RePiInt2& Size)
+{
+    if (Size != mSize)
+    {
+        mSize = Size;
+        mHistory.Invalidate();
+    }
+
+    mParity ^= 1;
+}
+
+void RePiCheckerboard::Resolve(
+    RePiTexture& Color,
+    const RePiTexture& Depth)
+{
+    if (Color.GetSize() != RePiFloat2(float(mSize.x), float(mSize.y)) || Depth.GetSize() != Color.GetSize())
+    {
+        return;
+    }
+
+#pragma omp parallel for
+    for (int32_t y = 0; y < mSize.y; ++y)
+    {
+        // Start on the first pixel of the unshaded half in this row
+        for (int32_t x = (y + mParity + 1) & 1; x < mSize.x; x += 2)
+        {
+            const RePiInt2 xy(x, y);
+
+            // Depth stays at the clear value where nothing was drawn
+            if (Depth.LoadData(xy) >= 1.f)
+            {
+                continue;
+            }
+
+            Color.WriteColor(xy, ReconstructPixel(Color, Depth, xy));
+        }
+    }
+
+    // The half shaded this frame is the half missing next frame
+    mHistory.Store(Color, Depth);
+}
+
+RePiLinearColor RePiCheckerboard::ReconstructPixel(
+    const RePiTexture& Color,
+    const RePiTexture& Depth,
+    const RePiInt2& xy) const
+{
+    const RePiInt2 Neighbors[4] = { RePiInt2(xy.x - 1, xy.y), RePiInt2(xy.x + 1, xy.y), RePiInt2(xy.x, xy.y - 1), RePiInt2(xy.x, xy.y + 1) };
+
+    const float CenterDepth = Depth.LoadData(xy);
+
+    RePiLinearColor Sum(0.f, 0.f, 0.f, 0.f);
+    RePiLinearColor Lo(1.f, 1.f, 1.f, 1.f);
+    RePiLinearColor Hi(0.f, 0.f, 0.f, 0.f);
+    RePiLinearColor Closest = RePiLinearColor::Black;
+    float ClosestDifference = -1.f;
+    float Weight = 0.f;
+
+    for (const RePiInt2& Neighbor : Neighbors)
+    {
+        if (Neighbor.x < 0 || Neighbor.x >= mSize.x || Neighbor.y < 0 || Neighbor.y >= mSize.y)
+        {
+            continue;
+        }
+
+        const float NeighborDepth = Depth.LoadData(Neighbor);
+        const float Difference = std::abs(NeighborDepth - CenterDepth);
+        const RePiLinearColor Sample = Color.LoadColor(Neighbor);
+
+        if (ClosestDifference < 0.f || Difference < ClosestDifference)
+        {
+            ClosestDifference = Difference;
+            Closest = Sample;
+        }
+
+        // Neighbors across a depth edge belong to another surface
+        if (!RePiFrameHistory::IsSameSurface(NeighborDepth, CenterDepth))
+        {
+            continue;
+        }
+
+        Sum.r += Sample.r;
+        Sum.g += Sample.g;
+        Sum.b += Sample.b;
+        Sum.a += Sample.a;
+        Weight += 1.f;
+
+        Lo = RePiLinearColor(RePiMath::min(Lo.r, Sample.r), RePiMath::min(Lo.g, Sample.g), RePiMath::min(Lo.b, Sample.b), RePiMath::min(Lo.a, Sample.a));
+        Hi = RePiLinearColor(RePiMath::max(Hi.r, Sample.r), RePiMath::max(Hi.g, Sample.g), RePiMath::max(Hi.b, Sample.b), RePiMath::max(Hi.a, Sample.a));
+    }
+
+    // Thin features with no neighbor on the same surface take the closest one
+    if (Weight <= 0.f)
+    {
+        return Closest;
+    }
+
+    // Last frame shaded this pixel, clamping it to the neighborhood keeps moving edges from ghosting
+    RePiLinearColor History;
+    if (mHistory.Load(xy, CenterDepth, History))
+    {
+        return RePiLinearColor(
+            RePiMath::clamp(History.r, Lo.r, Hi.r),
+            RePiMath::clamp(History.g, Lo.g, Hi.g),
+            RePiMath::clamp(History.b, Lo.b, Hi.b),
+            RePiMath::clamp(History.a, Lo.a, Hi.a));
+    }
+
+    const float InvWeight = 1.f / Weight;
+
+    return RePiLinearColor(Sum.r * InvWeight, Sum.g * InvWeight, Sum.b * InvWeight, Sum.a * InvWeight);
+}
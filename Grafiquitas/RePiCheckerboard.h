@@ -0,0 +1,46 @@
+#pragma once
+
+#include "RePiBase.h"
+#include "RePiFrameHistory.h"
+#include "RePiTexture.h"
+
+class RePiCheckerboard
+{
+public:
+    RePiCheckerboard();
+
+    ~RePiCheckerboard() = default;
+
+    // Flips which half gets shaded, history of another size is dropped
+    void BeginFrame(
+        const RePiInt2& Size = RePiInt2::ZERO);
+
+    bool IsShaded(
+        const RePiInt2& xy = RePiInt2::ZERO) const
+    {
+        return 0 == ((xy.x + xy.y + mParity) & 1);
+    }
+
+    // Fills the covered pixels of the unshaded half from their neighbors and last frame, needs a depth target
+    void Resolve(
+        RePiTexture& Color,
+        const RePiTexture& Depth);
+
+    void Invalidate()
+    {
+        mHistory.Invalidate();
+    }
+
+private:
+    RePiLinearColor ReconstructPixel(
+        const RePiTexture& Color,
+        const RePiTexture& Depth,
+        const RePiInt2& xy) const;
+
+private:
+    RePiFrameHistory mHistory;
+
+    RePiInt2 mSize;
+
+    uint32_t mParity;
+};
@@ -0,0 +1,66 @@
+#include "RePiDeferredShading.h"
+
+#include "RePiMaterial.h"
+
+RePiDeferredShading::RePiDeferredShading(
+    const uint32_t MaxDraws,
+    const std::string& Name) :
+    mMaxDraws(MaxDraws),
+    mName(Name)
+{
+}
+
+void RePiDeferredShading::Clear()
+{
+    mDraws.clear();
+}
+
+uint32_t RePiDeferredShading::RegisterDraw(
+    const std::weak_ptr<RePiMaterial>& Material,
+    const PixelShader& Shader)
+{
+    if (mDraws.size() >= mMaxDraws)
+    {
+        RePiLog(RePiLogLevel::eWARNING, mName + " draw table is full, the draw won't be shaded");
+        return mMaxDraws;
+    }
+
+    mDraws.push_back({ Material, Shader });
+
+    return static_cast<uint32_t>(mDraws.size() - 1);
+}
+
+void RePiDeferredShading::Shade(
+    const RePiInt2& Size,
+    const RePiSampleFilter MaxFilter,
+    const TileShader& ShadeTile)
+{
+    // Several draws usually share a material, binding twice is harmless
+    for (auto& Draw : mDraws)
+    {
+        if (auto pMaterial = Draw.Material.lock())
+        {
+            pMaterial->ResolveSamplers(MaxFilter);
+        }
+    }
+
+    const int32_t TilesWide = (Size.x + TileSize - 1) / TileSize;
+    const int32_t TilesHigh = (Size.y + TileSize - 1) / TileSize;
+
+#pragma omp parallel for schedule(dynamic)
+    for (int32_t Tile = 0; Tile < TilesWide * TilesHigh; ++Tile)
+    {
+        const RePiInt2 Min((Tile % TilesWide) * TileSize, (Tile / TilesWide) * TileSize);
+        const RePiInt2 Max(RePiMath::min(Min.x + TileSize, Size.x), RePiMath::min(Min.y + TileSize, Size.y));
+
+        ShadeTile(Min, Max);
+    }
+
+    for (auto& Draw : mDraws)
+    {
+        if (auto pMaterial = Draw.Material.lock())
+        {
+            pMaterial->ReleaseSamplers();
+        }
+    }
+}
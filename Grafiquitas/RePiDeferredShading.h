@@ -0,0 +1,60 @@
+#pragma once
+
+#include "RePiBase.h"
+#include "RePiRasterizerStage.h"
+
+class RePiMaterial;
+
+// Draw table and tiled shading loop shared by the G-buffer and the visibility buffer
+class RePiDeferredShading
+{
+public:
+    struct RePiDeferredDraw
+    {
+        std::weak_ptr<RePiMaterial> Material;
+        PixelShader Shader;
+    };
+
+    // Bounds of one tile, max exclusive
+    using TileShader = std::function<void(const RePiInt2&, const RePiInt2&)>;
+
+    // MaxDraws is both the table size and the id handed out once it's full, Name goes in the warning
+    RePiDeferredShading(
+        const uint32_t MaxDraws,
+        const std::string& Name);
+
+    ~RePiDeferredShading() = default;
+
+    void Clear();
+
+    uint32_t RegisterDraw(
+        const std::weak_ptr<RePiMaterial>& Material,
+        const PixelShader& Shader);
+
+    // Null for the empty id and for draws without a shader
+    const RePiDeferredDraw* GetDraw(
+        const uint32_t DrawID) const
+    {
+        return DrawID < mDraws.size() && mDraws[DrawID].Shader ? &mDraws[DrawID] : nullptr;
+    }
+
+    size_t GetDrawCount() const
+    {
+        return mDraws.size();
+    }
+
+    // Binds every draw's samplers, runs ShadeTile over 16x16 tiles in parallel and releases them
+    void Shade(
+        const RePiInt2& Size,
+        const RePiSampleFilter MaxFilter,
+        const TileShader& ShadeTile);
+
+private:
+    static const int32_t TileSize = 16;
+
+    uint32_t mMaxDraws;
+
+    std::string mName;
+
+    std::vector<RePiDeferredDraw> mDraws;
+};
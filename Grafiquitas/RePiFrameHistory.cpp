@@ -0,0 +1,43 @@
+#include "RePiFrameHistory.h"
+
+RePiFrameHistory::RePiFrameHistory() :
+    mValid(false)
+{
+}
+
+void RePiFrameHistory::Store(
+    const RePiTexture& Color,
+    const RePiTexture& Depth)
+{
+    // Same size every frame, so the copies reuse the history buffers
+    mColor = Color;
+    mDepth = Depth;
+
+    mValid = Depth.GetSize() == Color.GetSize();
+}
+
+bool RePiFrameHistory::Load(
+    const RePiInt2& xy,
+    const float Depth,
+    RePiLinearColor& Color) const
+{
+    if (!mValid || !IsSameSurface(mDepth.LoadData(xy), Depth))
+    {
+        return false;
+    }
+
+    Color = mColor.LoadColor(xy);
+
+    return true;
+}
+
+bool RePiFrameHistory::IsSameSurface(
+    const float DepthA,
+    const float DepthB)
+{
+    // 1 - depth goes with the inverse view distance, which keeps the comparison relative
+    const float DistanceA = 1.f - DepthA;
+    const float DistanceB = 1.f - DepthB;
+
+    return std::abs(DistanceA - DistanceB) <= DepthTolerance * std::abs(DistanceB);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "RePiBase.h"
+#include "RePiTexture.h"
+
+class RePiFrameHistory
+{
+public:
+    RePiFrameHistory();
+
+    ~RePiFrameHistory() = default;
+
+    // Keeps copies of this frame's targets, targets of different sizes leave the history invalid
+    void Store(
+        const RePiTexture& Color,
+        const RePiTexture& Depth);
+
+    // True when last frame's pixel at xy lies on the same surface as Depth, Color receives it
+    bool Load(
+        const RePiInt2& xy,
+        const float Depth,
+        RePiLinearColor& Color) const;
+
+    bool IsValid() const
+    {
+        return mValid;
+    }
+
+    void Invalidate()
+    {
+        mValid = false;
+    }
+
+    static bool IsSameSurface(
+        const float DepthA = 0.f,
+        const float DepthB = 0.f);
+
+private:
+    // Relative view distance difference past which two depths count as different surfaces
+    static constexpr float DepthTolerance = 0.02f;
+
+    RePiTexture mColor;
+
+    RePiTexture mDepth;
+
+    bool mValid;
+};
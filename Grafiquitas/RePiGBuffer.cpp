@@ -0,0 +1,151 @@
+#include "RePiGBuffer.h"
+
+#include "RePi3DModel.h"
+#include "RePiMaterial.h"
+#include "RePiTexture.h"
+
+RePiGBuffer::RePiGBuffer() :
+    mSize(RePiInt2::ZERO),
+    mShading(MaxDraws, "G-buffer")
+{
+}
+
+void RePiGBuffer::Clear(
+    const RePiInt2& Size)
+{
+    mSize = Size;
+
+    RePiGBufferTexel Empty;
+    Empty.NormalDraw = EmptyDraw << NormalBits;
+    mTexels.assign(static_cast<size_t>(mSize.x) * mSize.y, Empty);
+
+    mShading.Clear();
+}
+
+uint32_t RePiGBuffer::RegisterDraw(
+    const std::weak_ptr<RePiMaterial>& Material,
+    const PixelShader& Shader)
+{
+    return mShading.RegisterDraw(Material, Shader);
+}
+
+void RePiGBuffer::Shade(
+    RePiTexture& Target,
+    const std::weak_ptr<RasterizerConstantBuffer>& ConstantBuffer,
+    const RePiSampleFilter MaxFilter)
+{
+    if (Target.GetSize() != RePiFloat2(float(mSize.x), float(mSize.y)))
+    {
+        return;
+    }
+
+    mShading.Shade(mSize, MaxFilter, [&](const RePiInt2& Min, const RePiInt2& Max)
+    {
+        for (int32_t y = Min.y; y < Max.y; ++y)
+        {
+            for (int32_t x = Min.x; x < Max.x; ++x)
+            {
+                const RePiGBufferTexel& Texel = mTexels[static_cast<size_t>(y) * mSize.x + x];
+                const RePiDeferredShading::RePiDeferredDraw* pDraw = mShading.GetDraw(Texel.NormalDraw >> NormalBits);
+                if (nullptr == pDraw)
+                {
+                    continue;
+                }
+
+                const RePiInt2 xy(x, y);
+
+                RePiVertex V(RePiFloat3(float(x), float(y), Texel.Depth), Texel.TexCoord, DecodeNormal(Texel.NormalDraw));
+                V.TexCoordDdx = GetTexCoordDerivative(xy, RePiInt2(1, 0));
+                V.TexCoordDdy = GetTexCoordDerivative(xy, RePiInt2(0, 1));
+
+                Target.WriteColor(xy, pDraw->Shader(V, pDraw->Material, ConstantBuffer));
+            }
+        }
+    });
+}
+
+uint32_t RePiGBuffer::EncodeNormal(
+    const RePiFloat3& Normal)
+{
+    static const uint32_t HalfBits = NormalBits / 2;
+    static const float Scale = float((1u << HalfBits) - 1);
+
+    // Octahedral mapping folds the sphere onto a square
+    const float Length = std::abs(Normal.x) + std::abs(Normal.y) + std::abs(Normal.z);
+    if (Length <= 0.f)
+    {
+        return 0;
+    }
+
+    float ox = Normal.x / Length;
+    float oy = Normal.y / Length;
+    if (Normal.z < 0.f)
+    {
+        const float fx = (1.f - std::abs(oy)) * (ox >= 0.f ? 1.f : -1.f);
+        const float fy = (1.f - std::abs(ox)) * (oy >= 0.f ? 1.f : -1.f);
+        ox = fx;
+        oy = fy;
+    }
+
+    const uint32_t qx = static_cast<uint32_t>((ox * 0.5f + 0.5f) * Scale + 0.5f);
+    const uint32_t qy = static_cast<uint32_t>((oy * 0.5f + 0.5f) * Scale + 0.5f);
+
+    return qx | (qy << HalfBits);
+}
+
+RePiFloat3 RePiGBuffer::DecodeNormal(
+    const uint32_t Packed)
+{
+    static const uint32_t HalfBits = NormalBits / 2;
+    static const uint32_t Mask = (1u << HalfBits) - 1;
+    static const float Scale = float(Mask);
+
+    const float ox = float(Packed & Mask) / Scale * 2.f - 1.f;
+    const float oy = float((Packed >> HalfBits) & Mask) / Scale * 2.f - 1.f;
+    const float oz = 1.f - std::abs(ox) - std::abs(oy);
+
+    RePiFloat3 Normal(ox, oy, oz);
+    if (oz < 0.f)
+    {
+        Normal.x = (1.f - std::abs(oy)) * (ox >= 0.f ? 1.f : -1.f);
+        Normal.y = (1.f - std::abs(ox)) * (oy >= 0.f ? 1.f : -1.f);
+    }
+
+    return Normal.getSafeNormal();
+}
+
+RePiFloat2 RePiGBuffer::GetTexCoordDerivative(
+    const RePiInt2& xy,
+    const RePiInt2& Step) const
+{
+    const RePiGBufferTexel& Center = mTexels[static_cast<size_t>(xy.y) * mSize.x + xy.x];
+    const uint32_t DrawID = Center.NormalDraw >> NormalBits;
+
+    RePiFloat2 Result = RePiFloat2::ZERO;
+    float ResultSize = -1.f;
+
+    for (int32_t Side = -1; Side <= 1; Side += 2)
+    {
+        const RePiInt2 Neighbor(xy.x + Step.x * Side, xy.y + Step.y * Side);
+        if (Neighbor.x < 0 || Neighbor.x >= mSize.x || Neighbor.y < 0 || Neighbor.y >= mSize.y)
+        {
+            continue;
+        }
+
+        const RePiGBufferTexel& Texel = mTexels[static_cast<size_t>(Neighbor.y) * mSize.x + Neighbor.x];
+        if ((Texel.NormalDraw >> NormalBits) != DrawID)
+        {
+            continue;
+        }
+
+        const RePiFloat2 Difference = (Texel.TexCoord - Center.TexCoord) * float(Side);
+        const float Size = Difference.x * Difference.x + Difference.y * Difference.y;
+        if (ResultSize < 0.f || Size < ResultSize)
+        {
+            Result = Difference;
+            ResultSize = Size;
+        }
+    }
+
+    return Result;
+}
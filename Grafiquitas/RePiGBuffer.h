@@ -0,0 +1,86 @@
+#pragma once
+
+#include "RePiBase.h"
+#include "RePiDeferredShading.h"
+#include "RePiRasterizerStage.h"
+
+class RePiMaterial;
+class RePiTexture;
+
+// 16 bytes per pixel, octahedral normal and draw id share one word
+struct RePiGBufferTexel
+{
+    float Depth = 1.f;
+    RePiFloat2 TexCoord;
+    uint32_t NormalDraw = 0;
+};
+
+class RePiGBuffer
+{
+public:
+    RePiGBuffer();
+
+    ~RePiGBuffer() = default;
+
+    // Empties every pixel and the draw table, reallocates only when the size changes
+    void Clear(
+        const RePiInt2& Size = RePiInt2::ZERO);
+
+    // Records the material and shader a draw's pixels will be shaded with, returns its id
+    uint32_t RegisterDraw(
+        const std::weak_ptr<RePiMaterial>& Material,
+        const PixelShader& Shader);
+
+    // Callers must own the pixel, the rasterizer's row bands give each pixel one thread
+    void Write(
+        const RePiInt2& xy,
+        const float Depth,
+        const RePiFloat2& TexCoord,
+        const RePiFloat3& Normal,
+        const uint32_t DrawID)
+    {
+        RePiGBufferTexel Texel;
+        Texel.Depth = Depth;
+        Texel.TexCoord = TexCoord;
+        Texel.NormalDraw = EncodeNormal(Normal) | (DrawID << NormalBits);
+
+        // Packed first and stored whole, the texel is never half from one triangle and half from another
+        mTexels[static_cast<size_t>(xy.y) * mSize.x + xy.x] = Texel;
+    }
+
+    // Runs each visible pixel's shader once, tiles are shaded in parallel
+    void Shade(
+        RePiTexture& Target,
+        const std::weak_ptr<RasterizerConstantBuffer>& ConstantBuffer,
+        const RePiSampleFilter MaxFilter = RePiSampleFilter::eFILTER_ANISOTROPIC);
+
+    RePiInt2 GetSize() const
+    {
+        return mSize;
+    }
+
+    static const uint32_t NormalBits = 20;
+    static const uint32_t MaxDraws = (1u << (32 - NormalBits)) - 1;
+
+    // Draw id of pixels nothing was drawn to
+    static const uint32_t EmptyDraw = MaxDraws;
+
+private:
+    static uint32_t EncodeNormal(
+        const RePiFloat3& Normal);
+
+    static RePiFloat3 DecodeNormal(
+        const uint32_t Packed);
+
+    // Texcoord change to the next pixel on the same draw, the smaller side wins so seams don't blow up the footprint
+    RePiFloat2 GetTexCoordDerivative(
+        const RePiInt2& xy,
+        const RePiInt2& Step) const;
+
+private:
+    RePiInt2 mSize;
+
+    std::vector<RePiGBufferTexel> mTexels;
+
+    RePiDeferredShading mShading;
+};
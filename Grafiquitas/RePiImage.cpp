@@ -1,6 +1,19 @@
 #include "RePiImage.h"
 
+#include "RePiBlockCodec.h"
+#include "RePiMappedFile.h"
+
 static const uint16_t BMP_SIGNATURE = 0x4D42;
+static const uint32_t BAKED_SIGNATURE = 0x58545052;
+static const uint32_t DDS_SIGNATURE = 0x20534444;
+static const uint32_t DDS_FOURCC_DXT1 = 0x31545844;
+static const uint32_t DDS_FOURCC_DXT3 = 0x33545844;
+static const uint32_t DDS_FOURCC_DXT5 = 0x35545844;
+static const uint32_t DDS_FOURCC_DX10 = 0x30315844;
+static const uint32_t DDS_FORMAT_FOURCC = 0x4;
+static const uint32_t DDS_FORMAT_RGB = 0x40;
+static const uint32_t DDS_FORMAT_ALPHAPIXELS = 0x1;
+static const uint32_t BAKED_DATA_ALIGNMENT = 64;
 static const uint32_t RED_MASK_DEFAULT = 0x00FF0000;
 static const uint32_t GREEN_MASK_DEFAULT = 0x0000FF00;
 static const uint32_t BLUE_MASK_DEFAULT = 0x000000FF;
@@ -11,6 +24,9 @@ RePiImage::RePiImage()
     , mHeight(0)
     , mBitsPerPixel(0)
     , mChannels(0)
+    , mFormat(RePiTextureFormat::eUNKNOWN)
+    , mCacheKey(0u)
+    , mMappedOffset(0)
 {
 }
 
@@ -22,8 +38,30 @@ RePiImage::~RePiImage()
 bool RePiImage::Encode(
     const std::string& Filename)
 {
-    if (mWidth <= 0 || mHeight <= 0 ||
-        mBuffer.size() < static_cast<size_t>(mWidth * mHeight * GetBytesPerPixel()))
+    std::vector<uint8_t> Data;
+    if (!EncodeToMemory(Data))
+    {
+        return false;
+    }
+
+    std::ofstream File(Filename, std::ios::binary);
+    if (!File)
+    {
+        RePiLog(RePiLogLevel::eWARNING, "Unable to open file for writing: " + Filename);
+
+        return false;
+    }
+
+    // The whole file goes out in a single write
+    File.write(reinterpret_cast<const char*>(Data.data()), Data.size());
+
+    return true;
+}
+
+bool RePiImage::EncodeBaked(
+    const std::string& Filename)
+{
+    if (mWidth <= 0 || mHeight <= 0 || nullptr == GetPixels())
     {
         RePiLog(RePiLogLevel::eWARNING, "Invalid image data for encoding.");
 
@@ -38,8 +76,207 @@ bool RePiImage::Encode(
         return false;
     }
 
+    // Pixels are written exactly as they live in memory so Decode can map them without a copy
+    BakedHeader bakedHeader;
+    bakedHeader.Signature = BAKED_SIGNATURE;
+    bakedHeader.Width = mWidth;
+    bakedHeader.Height = mHeight;
+    bakedHeader.BitsPerPixel = mBitsPerPixel;
+    bakedHeader.Format = mFormat;
+    bakedHeader.OffsetData = (sizeof(BakedHeader) + BAKED_DATA_ALIGNMENT - 1) & ~(BAKED_DATA_ALIGNMENT - 1);
+    File.write(reinterpret_cast<const char*>(&bakedHeader), sizeof(BakedHeader));
+
+    char Padding[BAKED_DATA_ALIGNMENT] = { 0 };
+    File.write(Padding, bakedHeader.OffsetData - sizeof(BakedHeader));
+    File.write(reinterpret_cast<const char*>(GetPixels()), GetDataSize());
+
+    return true;
+}
+
+static const int32_t countTrailingZeros(
+    uint32_t value)
+{
+    // Return 32 if there are no set bits (all bits are zero)
+    return static_cast<int32_t>(std::countr_zero(value));
+}
+
+struct ChannelLayout
+{
+    uint32_t Mask[4];
+    uint32_t Shift[4];
+    int32_t SrcByte[4];
+    int32_t Count;
+    bool ByteAligned;
+};
+
+static const ChannelLayout BuildChannelLayout(
+    const uint32_t* Masks,
+    const int32_t SrcBpp)
+{
+    ChannelLayout Layout{};
+    Layout.ByteAligned = true;
+
+    // Masks are stored in output order (red, green, blue, alpha), empty masks are skipped
+    for (int32_t i = 0; i < 4; ++i)
+    {
+        if (Masks[i] == 0)
+        {
+            continue;
+        }
+
+        const int32_t Channel = Layout.Count++;
+        Layout.Mask[Channel] = Masks[i];
+        Layout.Shift[Channel] = countTrailingZeros(Masks[i]);
+        Layout.SrcByte[Channel] = Layout.Shift[Channel] >> 3;
+
+        if ((Layout.Shift[Channel] & 7) != 0 ||
+            (Masks[i] >> Layout.Shift[Channel]) != 0xFF ||
+            Layout.SrcByte[Channel] >= SrcBpp)
+        {
+            Layout.ByteAligned = false;
+        }
+    }
+
+    return Layout;
+}
+
+static void DecodeRowScalar(
+    const uint8_t* Src,
+    uint8_t* Dst,
+    const int32_t Width,
+    const int32_t SrcBpp,
+    const ChannelLayout& Layout)
+{
+    for (int32_t x = 0; x < Width; ++x, Src += SrcBpp)
+    {
+        uint32_t Pixel = Src[0];
+        if (SrcBpp > 1) Pixel |= static_cast<uint32_t>(Src[1]) << 8;
+        if (SrcBpp > 2) Pixel |= static_cast<uint32_t>(Src[2]) << 16;
+        if (SrcBpp > 3) Pixel |= static_cast<uint32_t>(Src[3]) << 24;
+
+        for (int32_t c = 0; c < Layout.Count; ++c)
+        {
+            *Dst++ = static_cast<uint8_t>((Pixel & Layout.Mask[c]) >> Layout.Shift[c]);
+        }
+    }
+}
+
+static void DecodeRowSwizzle(
+    const uint8_t* Src,
+    uint8_t* Dst,
+    const int32_t Width,
+    const int32_t SrcBpp,
+    const ChannelLayout& Layout)
+{
+    const int32_t DstBpp = Layout.Count;
+    int32_t x = 0;
+
+#if defined(REPI_SIMD_SSSE3)
+    // Every shuffle converts as many whole pixels as fit in 16 bytes of both the source and the destination
+    const int32_t PixelsPerStep = 16 / RePiMath::max(SrcBpp, DstBpp);
+
+    alignas(16) int8_t Control[16];
+    memset(Control, 0x80, sizeof(Control));
+    for (int32_t i = 0; i < PixelsPerStep; ++i)
+    {
+        for (int32_t c = 0; c < DstBpp; ++c)
+        {
+            Control[i * DstBpp + c] = static_cast<int8_t>(i * SrcBpp + Layout.SrcByte[c]);
+        }
+    }
+    const __m128i Shuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(Control));
+
+    // Stores write a full 16 bytes, the tail past the converted pixels is overwritten by the next step
+    for (; (x * SrcBpp) + 16 <= Width * SrcBpp && (x * DstBpp) + 16 <= Width * DstBpp; x += PixelsPerStep)
+    {
+        __m128i Pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Src + x * SrcBpp));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(Dst + x * DstBpp), _mm_shuffle_epi8(Pixels, Shuffle));
+    }
+#endif
+
+    for (; x < Width; ++x)
+    {
+        const uint8_t* SrcPixel = Src + x * SrcBpp;
+        uint8_t* DstPixel = Dst + x * DstBpp;
+
+        for (int32_t c = 0; c < DstBpp; ++c)
+        {
+            DstPixel[c] = SrcPixel[Layout.SrcByte[c]];
+        }
+    }
+}
+
+// Only red first files qualify: BI_BITFIELDS BMPs with red in the low byte, R8G8B8A8 DDS files and grayscale TGAs
+// Plain 24 bit BGR and 32 bit BGRA rows always need the swizzle, as memory keeps red in byte 0
+static const bool IsIdentityLayout(
+    const ChannelLayout& Layout,
+    const int32_t SrcBpp)
+{
+    bool Identity = Layout.ByteAligned && Layout.Count == SrcBpp;
+    for (int32_t c = 0; c < Layout.Count && Identity; ++c)
+    {
+        Identity = Layout.SrcByte[c] == c;
+    }
+
+    return Identity;
+}
+
+static void DecodeRows(
+    const uint8_t* PixelData,
+    uint8_t* Dst,
+    const int32_t Width,
+    const int32_t Height,
+    const int32_t RowSize,
+    const int32_t Pitch,
+    const int32_t SrcBpp,
+    const bool BottomUp,
+    const ChannelLayout& Layout)
+{
+    const bool Identity = IsIdentityLayout(Layout, SrcBpp);
+
+    for (int32_t y = 0; y < Height; ++y)
+    {
+        const uint8_t* SrcRow = PixelData + static_cast<size_t>(BottomUp ? Height - 1 - y : y) * RowSize;
+        uint8_t* DstRow = Dst + static_cast<size_t>(y) * Pitch;
+
+        if (Identity)
+        {
+            memcpy(DstRow, SrcRow, Pitch);
+        }
+        else if (Layout.ByteAligned)
+        {
+            DecodeRowSwizzle(SrcRow, DstRow, Width, SrcBpp, Layout);
+        }
+        else
+        {
+            DecodeRowScalar(SrcRow, DstRow, Width, SrcBpp, Layout);
+        }
+    }
+}
+
+bool RePiImage::EncodeToMemory(
+    std::vector<uint8_t>& Data) const
+{
+    if (mWidth <= 0 || mHeight <= 0 || nullptr == GetPixels() ||
+        (!IsMapped() && mBuffer.size() < GetDataSize()))
+    {
+        RePiLog(RePiLogLevel::eWARNING, "Invalid image data for encoding.");
+
+        return false;
+    }
+
+    // BMP has no block compressed layout, write a decompressed copy instead
+    if (IsBlockCompressed())
+    {
+        RePiImage Decompressed = *this;
+        Decompressed.Decompress();
+
+        return Decompressed.EncodeToMemory(Data);
+    }
+
     // Calculate row and data sizes
-    const int32_t RowSize = (mWidth * GetBytesPerPixel() + 3) & ~3;
+    const int32_t RowBytes = mWidth * GetBytesPerPixel();
+    const int32_t RowSize = (RowBytes + 3) & ~3;
     const int32_t DataSize = RowSize * mHeight;
 
     // Write BMP header
@@ -47,7 +284,6 @@ bool RePiImage::Encode(
     bmpHeader.Signature = BMP_SIGNATURE;
     bmpHeader.OffsetData = sizeof(BMPHeader) + sizeof(DIBHeader);
     bmpHeader.FileSize = bmpHeader.OffsetData + DataSize;
-    File.write(reinterpret_cast<const char*>(&bmpHeader), sizeof(BMPHeader));
 
     // Write DIB header
     DIBHeader dibHeader;
@@ -58,59 +294,104 @@ bool RePiImage::Encode(
     dibHeader.BitsPerPixel = mBitsPerPixel;
     dibHeader.Compression = 0;
     dibHeader.ImageSize = DataSize;
-    File.write(reinterpret_cast<const char*>(&dibHeader), sizeof(DIBHeader));
 
-    // Write pixel data (bottom-up order for BMP)
-    char Padding[3] = { 0 }; // Maximum padding size is 3 bytes
-    const int32_t PaddingSize = RowSize - mWidth * GetBytesPerPixel();
+    // Row padding stays zeroed
+    Data.assign(bmpHeader.FileSize, 0);
+    std::memcpy(Data.data(), &bmpHeader, sizeof(BMPHeader));
+    std::memcpy(Data.data() + sizeof(BMPHeader), &dibHeader, sizeof(DIBHeader));
 
-    for (int32_t y = mHeight - 1; y >= 0; --y)
-    {
-        size_t RowStart = static_cast<size_t>(y * mWidth * GetBytesPerPixel());
-        File.write(reinterpret_cast<const char*>(mBuffer.data() + RowStart), static_cast<size_t>(mWidth * GetBytesPerPixel()));
+    // Write pixel data (bottom-up order for BMP), which stores blue first where we store red first
+    const int32_t Bpp = static_cast<int32_t>(GetBytesPerPixel());
+    const uint32_t Masks[4] = { 0x00FF0000u, 0x0000FF00u, 0x000000FFu, Bpp >= 4 ? 0xFF000000u : 0u };
+    const ChannelLayout Layout = BuildChannelLayout(Masks, Bpp);
 
-        if (PaddingSize > 0)
+    const uint8_t* Pixels = GetPixels();
+    uint8_t* Dst = Data.data() + bmpHeader.OffsetData;
+    for (int32_t y = mHeight - 1; y >= 0; --y, Dst += RowSize)
+    {
+        const uint8_t* Src = Pixels + static_cast<size_t>(y) * RowBytes;
+        if (Bpp >= 3)
         {
-            File.write(Padding, PaddingSize);
+            DecodeRowSwizzle(Src, Dst, mWidth, Bpp, Layout);
+        }
+        else
+        {
+            std::memcpy(Dst, Src, RowBytes);
         }
     }
 
     return true;
 }
 
-static const int32_t countTrailingZeros(
-    uint32_t value)
+bool RePiImage::Decode(
+    const std::string& Filename)
 {
-    // Create a 32-bit bitset from the integer value
-    std::bitset<32> Bits(value);
+    auto MappedFile = std::make_shared<RePiMappedFile>();
+    if (!MappedFile->Open(Filename))
+    {
+        RePiLog(RePiLogLevel::eWARNING, "Unable to open file: " + Filename);
+
+        return false;
+    }
+
+    mMappedFile.reset();
+    mMappedOffset = 0;
+    mFormat = RePiTextureFormat::eUNKNOWN;
+    mCacheKey = RePiBlockCodec::NewCacheKey();
+
+    uint32_t Signature = 0u;
+    memcpy(&Signature, MappedFile->GetData(), RePiMath::min(MappedFile->GetSize(), sizeof(Signature)));
+
+    if (Signature == BAKED_SIGNATURE)
+    {
+        return DecodeBaked(MappedFile, Filename);
+    }
+
+    if (Signature == DDS_SIGNATURE)
+    {
+        return DecodeDDS(MappedFile, Filename);
+    }
+
+    if ((Signature & 0xFFFF) == BMP_SIGNATURE)
+    {
+        return DecodeBMP(MappedFile, Filename);
+    }
 
-    for (int32_t i = 0; i < 32; ++i)
+    // TGA carries no signature, fall back on the extension
+    const auto ExtensionIndex = Filename.find_last_of(".");
+    if (ExtensionIndex != std::string::npos)
     {
-        // Return the index of the first set bit (counting from the least significant bit)
-        if (Bits[i] == 1)
+        std::string Extension = Filename.substr(ExtensionIndex + 1);
+        std::transform(Extension.begin(), Extension.end(), Extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+        if (Extension == "tga")
         {
-            return i;
+            return DecodeTGA(MappedFile, Filename);
         }
     }
 
-    // Return 32 if there are no set bits (all bits are zero)
-    return 32;
+    RePiLog(RePiLogLevel::eWARNING, "Unrecognized image format in file: " + Filename);
+
+    return false;
 }
 
-bool RePiImage::Decode(
+bool RePiImage::DecodeBMP(
+    const std::shared_ptr<RePiMappedFile>& MappedFile,
     const std::string& Filename)
 {
-    std::ifstream File(Filename, std::ios::binary);
-    if (!File)
+    const uint8_t* FileData = MappedFile->GetData();
+    const size_t FileSize = MappedFile->GetSize();
+
+    if (FileSize < sizeof(BMPHeader) + sizeof(DIBHeader))
     {
-        RePiLog(RePiLogLevel::eWARNING, "Unable to open file: " + Filename);
+        RePiLog(RePiLogLevel::eWARNING, "File " + Filename + " is not a valid BMP");
 
         return false;
     }
 
     // Read BMP header
     BMPHeader bmpHeader;
-    File.read(reinterpret_cast<char*>(&bmpHeader), sizeof(BMPHeader));
+    memcpy(&bmpHeader, FileData, sizeof(BMPHeader));
     if (bmpHeader.Signature != BMP_SIGNATURE)
     {
         RePiLog(RePiLogLevel::eWARNING, "File " + Filename + " is not a valid BMP");
@@ -118,14 +399,9 @@ bool RePiImage::Decode(
         return false;
     }
 
-    // Read the DIB header size
-    uint32_t dibHeaderSize = 0u;
-    File.read(reinterpret_cast<char*>(&dibHeaderSize), sizeof(dibHeaderSize));
-
     // Read DIB header
     DIBHeader dibHeader;
-    File.seekg(sizeof(BMPHeader), std::ios::beg);
-    File.read(reinterpret_cast<char*>(&dibHeader), sizeof(DIBHeader));
+    memcpy(&dibHeader, FileData + sizeof(BMPHeader), sizeof(DIBHeader));
     if (dibHeader.BitsPerPixel < 8 ||
         (dibHeader.Compression != 0 && dibHeader.Compression != 3))
     {
@@ -143,74 +419,363 @@ bool RePiImage::Decode(
         maskHeader.BlueMask = dibHeader.BitsPerPixel >= 24 ? BLUE_MASK_DEFAULT : 0;
         maskHeader.AlphaMask = dibHeader.BitsPerPixel >= 32 ? ALPHA_MASK_DEFAULT : 0;
     }
-    else if (dibHeaderSize >= sizeof(DIBHeader) + sizeof(MaskHeader))
+    else if (dibHeader.HeaderSize >= sizeof(DIBHeader) + sizeof(MaskHeader) &&
+             FileSize >= sizeof(BMPHeader) + sizeof(DIBHeader) + sizeof(MaskHeader))
     {
-        File.read(reinterpret_cast<char*>(&maskHeader), sizeof(MaskHeader));
+        memcpy(&maskHeader, FileData + sizeof(BMPHeader) + sizeof(DIBHeader), sizeof(MaskHeader));
     }
 
-    // Calculate the number of channels
-    mChannels += maskHeader.RedMask == 0 ? 0 : 1;
-    mChannels += maskHeader.GreenMask == 0 ? 0 : 1;
-    mChannels += maskHeader.BlueMask == 0 ? 0 : 1;
-    mChannels += maskHeader.AlphaMask == 0 ? 0 : 1;
+    // Extract raw image properties
+    const int32_t Bpp = dibHeader.BitsPerPixel >> 3;
+    const uint32_t Masks[4] = { maskHeader.RedMask, maskHeader.GreenMask, maskHeader.BlueMask, maskHeader.AlphaMask };
+    const ChannelLayout Layout = BuildChannelLayout(Masks, Bpp);
 
     // Set image properties
+    mChannels = Layout.Count;
     mWidth = dibHeader.Width;
     mHeight = std::abs(dibHeader.Height);
     mBitsPerPixel = 8 * mChannels;
-    mBuffer.resize(static_cast<size_t>(GetPitch() * mHeight));
+    mFormat = GetUnormFormat(mChannels);
 
-    // Extract raw image properties
-    const int32_t Bpp = dibHeader.BitsPerPixel >> 3;
+    const int32_t Pitch = static_cast<int32_t>(GetPitch());
     const int32_t RowSize = (mWidth * Bpp + 3) & ~3;
-    const int32_t DataSize = RowSize * dibHeader.Height;
-    std::vector<unsigned char> tempBuffer(DataSize);
+    const size_t DataSize = static_cast<size_t>(RowSize) * mHeight;
+    const bool BottomUp = dibHeader.Height > 0;
 
-    // Read pixel data (BMP stores rows bottom-to-top)
-    File.seekg(bmpHeader.OffsetData, std::ios::beg);
-    File.read(reinterpret_cast<char*>(tempBuffer.data()), DataSize);
+    if (bmpHeader.OffsetData + DataSize > FileSize)
+    {
+        RePiLog(RePiLogLevel::eWARNING, "Truncated pixel data in file: " + Filename);
+
+        return false;
+    }
 
-    // Decode pixel data
-    for (int32_t y = 0; y < mHeight; ++y)
+    // The on-disk rows already match our layout, reference the mapped pages directly
+    if (IsIdentityLayout(Layout, Bpp) && RowSize == Pitch && !BottomUp)
     {
-        int32_t srcRowIndex = (dibHeader.Height > 0 ? mHeight - 1 - y : y) * RowSize;
+        mBuffer.clear();
+        mBuffer.shrink_to_fit();
+        mMappedFile = MappedFile;
+        mMappedOffset = bmpHeader.OffsetData;
 
-        for (int32_t x = 0; x < mWidth; ++x)
-        {
-            uint32_t pixel = 0;
-            memcpy(&pixel, &tempBuffer[static_cast<size_t>(srcRowIndex + (x * Bpp))], Bpp);
+        return true;
+    }
 
-            size_t pixelIndex = static_cast<size_t>(y * mWidth * GetBytesPerPixel() + x * GetBytesPerPixel());
+    // Decode pixel data (BMP stores rows bottom-to-top)
+    mBuffer.resize(static_cast<size_t>(Pitch) * mHeight);
+    DecodeRows(FileData + bmpHeader.OffsetData, mBuffer.data(), mWidth, mHeight, RowSize, Pitch, Bpp, BottomUp, Layout);
 
-            if (maskHeader.RedMask != 0)
-            {
-                mBuffer[pixelIndex++] = (pixel & maskHeader.RedMask) >> countTrailingZeros(maskHeader.RedMask);
-            }
+    return true;
+}
+
+bool RePiImage::DecodeBaked(
+    const std::shared_ptr<RePiMappedFile>& MappedFile,
+    const std::string& Filename)
+{
+    if (MappedFile->GetSize() < sizeof(BakedHeader))
+    {
+        RePiLog(RePiLogLevel::eWARNING, "File " + Filename + " is not a valid baked texture");
+
+        return false;
+    }
+
+    BakedHeader bakedHeader;
+    memcpy(&bakedHeader, MappedFile->GetData(), sizeof(BakedHeader));
+
+    // Only the layouts EncodeBaked can produce, anything else would be sampled with the wrong stride
+    const RePiTextureFormat Format = bakedHeader.Format <= eBC3_UNORM_SRGB ? static_cast<RePiTextureFormat>(bakedHeader.Format) : eUNKNOWN;
+    const bool BlockCompressed = RePiBlockCodec::IsBlockCompressed(Format);
+    const bool Valid = BlockCompressed ?
+        bakedHeader.BitsPerPixel == 32 :
+        (bakedHeader.BitsPerPixel == 24 || bakedHeader.BitsPerPixel == 32) && GetUnormFormat(bakedHeader.BitsPerPixel >> 3) == GetColorSpaceFormat(Format, false);
+
+    if (!Valid)
+    {
+        RePiLog(RePiLogLevel::eWARNING, "Unsupported baked texture format in file: " + Filename);
+
+        return false;
+    }
+
+    mWidth = bakedHeader.Width;
+    mHeight = bakedHeader.Height;
+    mBitsPerPixel = bakedHeader.BitsPerPixel;
+    mChannels = mBitsPerPixel >> 3;
+    mFormat = Format;
+
+    if (mWidth <= 0 || mHeight <= 0 ||
+        static_cast<uint64_t>(bakedHeader.OffsetData) + GetDataSize() > MappedFile->GetSize())
+    {
+        RePiLog(RePiLogLevel::eWARNING, "Truncated pixel data in file: " + Filename);
+
+        return false;
+    }
+
+    mBuffer.clear();
+    mBuffer.shrink_to_fit();
+    mMappedFile = MappedFile;
+    mMappedOffset = bakedHeader.OffsetData;
+
+    return true;
+}
+
+bool RePiImage::DecodeTGA(
+    const std::shared_ptr<RePiMappedFile>& MappedFile,
+    const std::string& Filename)
+{
+    const uint8_t* FileData = MappedFile->GetData();
+    const size_t FileSize = MappedFile->GetSize();
+
+    TGAHeader tgaHeader;
+    if (FileSize < sizeof(TGAHeader))
+    {
+        RePiLog(RePiLogLevel::eWARNING, "File " + Filename + " is not a valid TGA");
+
+        return false;
+    }
+    memcpy(&tgaHeader, FileData, sizeof(TGAHeader));
+
+    const bool RLE = tgaHeader.ImageType >= 8;
+    const uint8_t BaseType = tgaHeader.ImageType & 7;
+    const int32_t Bpp = tgaHeader.BitsPerPixel >> 3;
+
+    if (tgaHeader.ColorMapType != 0 ||
+        !((BaseType == 2 && (Bpp == 3 || Bpp == 4)) || (BaseType == 3 && Bpp == 1)))
+    {
+        RePiLog(RePiLogLevel::eWARNING, "Unsupported TGA format in file: " + Filename);
+
+        return false;
+    }
+
+    // Truecolor is stored BGR(A), grayscale is expanded to three channels
+    const uint32_t Masks[4] = {
+        BaseType == 3 ? 0x000000FFu : RED_MASK_DEFAULT,
+        BaseType == 3 ? 0x000000FFu : GREEN_MASK_DEFAULT,
+        BLUE_MASK_DEFAULT,
+        Bpp == 4 ? ALPHA_MASK_DEFAULT : 0u };
+    const ChannelLayout Layout = BuildChannelLayout(Masks, Bpp);
+
+    mChannels = Layout.Count;
+    mWidth = tgaHeader.Width;
+    mHeight = tgaHeader.Height;
+    mBitsPerPixel = 8 * mChannels;
+    mFormat = GetUnormFormat(mChannels);
+
+    const int32_t Pitch = static_cast<int32_t>(GetPitch());
+    const int32_t RowSize = mWidth * Bpp;
+    const size_t DataSize = static_cast<size_t>(RowSize) * mHeight;
+    const bool BottomUp = (tgaHeader.Descriptor & 0x20) == 0;
+    const size_t OffsetData = sizeof(TGAHeader) + tgaHeader.IdLength;
+
+    if (mWidth <= 0 || mHeight <= 0 || OffsetData > FileSize)
+    {
+        RePiLog(RePiLogLevel::eWARNING, "Truncated pixel data in file: " + Filename);
+
+        return false;
+    }
+
+    const uint8_t* PixelData = FileData + OffsetData;
+    std::vector<uint8_t> Expanded;
+
+    if (RLE)
+    {
+        // Expand the packets into raw file pixels first, rows are then converted like uncompressed data
+        Expanded.resize(DataSize);
 
-            if (maskHeader.GreenMask != 0)
+        const uint8_t* Src = PixelData;
+        const uint8_t* SrcEnd = FileData + FileSize;
+        size_t Written = 0;
+
+        while (Written < DataSize && Src < SrcEnd)
+        {
+            const uint8_t Packet = *Src++;
+            const size_t Count = RePiMath::min(static_cast<size_t>((Packet & 0x7F) + 1) * Bpp, DataSize - Written);
+
+            if (Packet & 0x80)
             {
-                mBuffer[pixelIndex++] = (pixel & maskHeader.GreenMask) >> countTrailingZeros(maskHeader.GreenMask);
-            }
+                if (Src + Bpp > SrcEnd)
+                {
+                    break;
+                }
 
-            if (maskHeader.BlueMask != 0)
+                for (size_t i = 0; i < Count; i += Bpp)
+                {
+                    memcpy(&Expanded[Written + i], Src, Bpp);
+                }
+                Src += Bpp;
+            }
+            else
             {
-                mBuffer[pixelIndex++] = (pixel & maskHeader.BlueMask) >> countTrailingZeros(maskHeader.BlueMask);
+                if (Src + Count > SrcEnd)
+                {
+                    break;
+                }
+
+                memcpy(&Expanded[Written], Src, Count);
+                Src += Count;
             }
 
-            if (maskHeader.AlphaMask != 0)
+            Written += Count;
+        }
+
+        if (Written < DataSize)
+        {
+            RePiLog(RePiLogLevel::eWARNING, "Truncated pixel data in file: " + Filename);
+
+            return false;
+        }
+
+        PixelData = Expanded.data();
+    }
+    else if (OffsetData + DataSize > FileSize)
+    {
+        RePiLog(RePiLogLevel::eWARNING, "Truncated pixel data in file: " + Filename);
+
+        return false;
+    }
+
+    mBuffer.resize(static_cast<size_t>(Pitch) * mHeight);
+    DecodeRows(PixelData, mBuffer.data(), mWidth, mHeight, RowSize, Pitch, Bpp, BottomUp, Layout);
+
+    return true;
+}
+
+bool RePiImage::DecodeDDS(
+    const std::shared_ptr<RePiMappedFile>& MappedFile,
+    const std::string& Filename)
+{
+    const uint8_t* FileData = MappedFile->GetData();
+    const size_t FileSize = MappedFile->GetSize();
+
+    DDSHeader ddsHeader;
+    if (FileSize < sizeof(DDSHeader))
+    {
+        RePiLog(RePiLogLevel::eWARNING, "File " + Filename + " is not a valid DDS");
+
+        return false;
+    }
+    memcpy(&ddsHeader, FileData, sizeof(DDSHeader));
+
+    size_t OffsetData = sizeof(DDSHeader);
+    RePiTextureFormat Format = RePiTextureFormat::eUNKNOWN;
+
+    if (ddsHeader.FormatFlags & DDS_FORMAT_FOURCC)
+    {
+        switch (ddsHeader.FourCC)
+        {
+        case DDS_FOURCC_DXT1:
+            Format = RePiTextureFormat::eBC1_UNORM;
+            break;
+        case DDS_FOURCC_DXT3:
+            Format = RePiTextureFormat::eBC2_UNORM;
+            break;
+        case DDS_FOURCC_DXT5:
+            Format = RePiTextureFormat::eBC3_UNORM;
+            break;
+        case DDS_FOURCC_DX10:
+        {
+            DDSHeaderDX10 dx10Header{};
+            if (FileSize < OffsetData + sizeof(DDSHeaderDX10))
             {
-                mBuffer[pixelIndex++] = (pixel & maskHeader.AlphaMask) >> countTrailingZeros(maskHeader.AlphaMask);
+                break;
             }
+            memcpy(&dx10Header, FileData + OffsetData, sizeof(DDSHeaderDX10));
+            OffsetData += sizeof(DDSHeaderDX10);
+
+            // DXGI_FORMAT_BC1_UNORM(_SRGB), BC2 and BC3 share their block layout with the legacy FourCCs
+            if (dx10Header.DXGIFormat == 71) Format = RePiTextureFormat::eBC1_UNORM;
+            if (dx10Header.DXGIFormat == 72) Format = RePiTextureFormat::eBC1_UNORM_SRGB;
+            if (dx10Header.DXGIFormat == 74) Format = RePiTextureFormat::eBC2_UNORM;
+            if (dx10Header.DXGIFormat == 75) Format = RePiTextureFormat::eBC2_UNORM_SRGB;
+            if (dx10Header.DXGIFormat == 77) Format = RePiTextureFormat::eBC3_UNORM;
+            if (dx10Header.DXGIFormat == 78) Format = RePiTextureFormat::eBC3_UNORM_SRGB;
+            break;
         }
+        default:
+            break;
+        }
+
+        if (Format == RePiTextureFormat::eUNKNOWN)
+        {
+            RePiLog(RePiLogLevel::eWARNING, "Unsupported DDS format in file: " + Filename);
+
+            return false;
+        }
+    }
+
+    mWidth = static_cast<int32_t>(ddsHeader.Width);
+    mHeight = static_cast<int32_t>(ddsHeader.Height);
+
+    // Block compressed data is sampled in place, only the top mip level is used
+    if (RePiBlockCodec::IsBlockCompressed(Format))
+    {
+        mChannels = 4;
+        mBitsPerPixel = 32;
+        mFormat = Format;
+
+        if (mWidth <= 0 || mHeight <= 0 || OffsetData + GetDataSize() > FileSize)
+        {
+            RePiLog(RePiLogLevel::eWARNING, "Truncated pixel data in file: " + Filename);
+
+            return false;
+        }
+
+        mBuffer.clear();
+        mBuffer.shrink_to_fit();
+        mMappedFile = MappedFile;
+        mMappedOffset = OffsetData;
+
+        return true;
     }
 
+    if (!(ddsHeader.FormatFlags & DDS_FORMAT_RGB) || ddsHeader.RGBBitCount < 8)
+    {
+        RePiLog(RePiLogLevel::eWARNING, "Unsupported DDS format in file: " + Filename);
+
+        return false;
+    }
+
+    const int32_t Bpp = ddsHeader.RGBBitCount >> 3;
+    const uint32_t Masks[4] = {
+        ddsHeader.RedMask,
+        ddsHeader.GreenMask,
+        ddsHeader.BlueMask,
+        (ddsHeader.FormatFlags & DDS_FORMAT_ALPHAPIXELS) ? ddsHeader.AlphaMask : 0u };
+    const ChannelLayout Layout = BuildChannelLayout(Masks, Bpp);
+
+    mChannels = Layout.Count;
+    mBitsPerPixel = 8 * mChannels;
+    mFormat = GetUnormFormat(mChannels);
+
+    const int32_t Pitch = static_cast<int32_t>(GetPitch());
+    const int32_t RowSize = mWidth * Bpp;
+
+    if (mWidth <= 0 || mHeight <= 0 || OffsetData + static_cast<size_t>(RowSize) * mHeight > FileSize)
+    {
+        RePiLog(RePiLogLevel::eWARNING, "Truncated pixel data in file: " + Filename);
+
+        return false;
+    }
+
+    if (IsIdentityLayout(Layout, Bpp))
+    {
+        mBuffer.clear();
+        mBuffer.shrink_to_fit();
+        mMappedFile = MappedFile;
+        mMappedOffset = OffsetData;
+
+        return true;
+    }
+
+    mBuffer.resize(static_cast<size_t>(Pitch) * mHeight);
+    DecodeRows(FileData + OffsetData, mBuffer.data(), mWidth, mHeight, RowSize, Pitch, Bpp, false, Layout);
+
     return true;
 }
 
 const RePiColor RePiImage::GetPixel(
     const RePiInt2& xy) const
 {
-    if (mBuffer.empty() ||
+    const uint8_t* Pixels = GetPixels();
+    if (nullptr == Pixels ||
         xy.x >= mWidth || xy.x < 0 ||
         xy.y >= mHeight || xy.y < 0)
     {
@@ -219,16 +784,28 @@ const RePiColor RePiImage::GetPixel(
         return RePiColor::Black;
     }
 
-    size_t PixelPos = static_cast<size_t>((xy.y * GetPitch()) + (xy.x * GetBytesPerPixel()));
+    const uint8_t* Texel = nullptr;
+    if (IsBlockCompressed())
+    {
+        const uint32_t BlockIndex = (xy.y >> 2) * RePiBlockCodec::GetBlocksWide(mWidth) + (xy.x >> 2);
+        const uint8_t* Block = Pixels + static_cast<size_t>(BlockIndex) * RePiBlockCodec::GetBlockBytes(mFormat);
+
+        Texel = RePiBlockCodec::FetchBlock(mFormat, mCacheKey, BlockIndex, Block) + (((xy.y & 3) << 2) + (xy.x & 3)) * 4;
+    }
+    else
+    {
+        Texel = Pixels + static_cast<size_t>((xy.y * GetPitch()) + (xy.x * GetBytesPerPixel()));
+    }
+
     RePiColor Color = RePiColor::Black;
 
-    Color.b = mBuffer[PixelPos++];
-    Color.g = mBuffer[PixelPos++];
-    Color.r = mBuffer[PixelPos++];
+    Color.b = Texel[0];
+    Color.g = Texel[1];
+    Color.r = Texel[2];
 
     if (GetBytesPerPixel() >= 4)
     {
-        Color.a = mBuffer[PixelPos];
+        Color.a = Texel[3];
     }
     else
     {
@@ -242,22 +819,27 @@ void RePiImage::SetPixel(
     const RePiColor& Color,
     const RePiInt2& xy)
 {
-    if (mBuffer.empty() ||
-        xy.x >= mWidth || xy.x < 0 ||
+    if (xy.x >= mWidth || xy.x < 0 ||
         xy.y >= mHeight || xy.y < 0)
     {
         return;
     }
 
+    uint8_t* Pixels = GetWritablePixels();
+    if (nullptr == Pixels)
+    {
+        return;
+    }
+
     size_t PixelPos = static_cast<size_t>((xy.y * GetPitch()) + (xy.x * GetBytesPerPixel()));
 
-    mBuffer[PixelPos++] = Color.b;
-    mBuffer[PixelPos++] = Color.g;
-    mBuffer[PixelPos++] = Color.r;
+    Pixels[PixelPos++] = Color.b;
+    Pixels[PixelPos++] = Color.g;
+    Pixels[PixelPos++] = Color.r;
 
     if (GetBytesPerPixel() >= 4)
     {
-        mBuffer[PixelPos] = Color.a;
+        Pixels[PixelPos] = Color.a;
     }
 }
 
@@ -267,18 +849,292 @@ void RePiImage::Clear(
     const auto& Bpp = GetBytesPerPixel();
     const auto& Pitch = GetPitch();
 
+    uint8_t* Pixels = GetWritablePixels();
+    if (nullptr == Pixels)
+    {
+        return;
+    }
+
     for (size_t x = 0; x < mWidth; ++x)
     {
-        memcpy(&mBuffer[x * Bpp], &Color, Bpp);
+        memcpy(&Pixels[x * Bpp], &Color, Bpp);
     }
 
     for (size_t y = 1; y < mHeight; ++y)
     {
-        memcpy(&mBuffer[y * Pitch], &mBuffer[(y - 1) * Pitch], Pitch);
+        memcpy(&Pixels[y * Pitch], &Pixels[(y - 1) * Pitch], Pitch);
     }
 }
 
 void* RePiImage::GetData()
 {
-    return mBuffer.data();
+    return GetWritablePixels();
+}
+
+bool RePiImage::MakeWritable()
+{
+    // Blocks can't be written texel by texel, expand them into a plain buffer first
+    if (IsBlockCompressed())
+    {
+        Decompress();
+    }
+
+    // The mapped view is read-only, pull the pixels into our own buffer
+    if (nullptr != mMappedFile)
+    {
+        const uint8_t* MappedPixels = GetPixels();
+
+        mBuffer.assign(MappedPixels, MappedPixels + GetDataSize());
+        mMappedFile.reset();
+        mMappedOffset = 0;
+    }
+
+    return !mBuffer.empty();
+}
+
+const uint8_t* RePiImage::GetPixels() const
+{
+    if (nullptr != mMappedFile)
+    {
+        return mMappedFile->GetData() + mMappedOffset;
+    }
+
+    return mBuffer.empty() ? nullptr : mBuffer.data();
+}
+
+uint8_t* RePiImage::GetWritablePixels()
+{
+    // Copy on write, callers that know up front can pay for it at load time through MakeWritable
+    if ((nullptr != mMappedFile || IsBlockCompressed()) && !MakeWritable())
+    {
+        RePiLog(RePiLogLevel::eWARNING, "Unable to make the image writable.");
+
+        return nullptr;
+    }
+
+    return mBuffer.empty() ? nullptr : mBuffer.data();
+}
+
+RePiTextureFormat RePiImage::GetUnormFormat(
+    const int32_t Channels)
+{
+    switch (Channels)
+    {
+    case 3:
+        return RePiTextureFormat::eR8G8B8_UNORM;
+    case 4:
+        return RePiTextureFormat::eR8G8B8A8_UNORM;
+    default:
+        return RePiTextureFormat::eUNKNOWN;
+    }
+}
+
+RePiTextureFormat RePiImage::GetColorSpaceFormat(
+    const RePiTextureFormat Format,
+    const bool SRGB)
+{
+    switch (Format)
+    {
+    case eR8G8B8A8_UNORM:
+    case eR8G8B8A8_UNORM_SRGB:
+        return SRGB ? eR8G8B8A8_UNORM_SRGB : eR8G8B8A8_UNORM;
+    case eR8G8B8_UNORM:
+    case eR8G8B8_UNORM_SRGB:
+        return SRGB ? eR8G8B8_UNORM_SRGB : eR8G8B8_UNORM;
+    case eBC1_UNORM:
+    case eBC1_UNORM_SRGB:
+        return SRGB ? eBC1_UNORM_SRGB : eBC1_UNORM;
+    case eBC2_UNORM:
+    case eBC2_UNORM_SRGB:
+        return SRGB ? eBC2_UNORM_SRGB : eBC2_UNORM;
+    case eBC3_UNORM:
+    case eBC3_UNORM_SRGB:
+        return SRGB ? eBC3_UNORM_SRGB : eBC3_UNORM;
+    default:
+        return Format;
+    }
+}
+
+bool RePiImage::IsSRGB() const
+{
+    switch (mFormat)
+    {
+    case eR8G8B8A8_UNORM_SRGB:
+    case eR8G8B8_UNORM_SRGB:
+    case eBC1_UNORM_SRGB:
+    case eBC2_UNORM_SRGB:
+    case eBC3_UNORM_SRGB:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void RePiImage::SetSRGB(
+    const bool SRGB)
+{
+    mFormat = GetColorSpaceFormat(mFormat, SRGB);
+}
+
+bool RePiImage::IsBlockCompressed() const
+{
+    return RePiBlockCodec::IsBlockCompressed(mFormat);
+}
+
+size_t RePiImage::GetDataSize() const
+{
+    if (IsBlockCompressed())
+    {
+        const size_t BlocksHigh = RePiBlockCodec::GetBlocksWide(mHeight);
+
+        return BlocksHigh * RePiBlockCodec::GetBlocksWide(mWidth) * RePiBlockCodec::GetBlockBytes(mFormat);
+    }
+
+    return static_cast<size_t>(GetPitch()) * mHeight;
+}
+
+bool RePiImage::Compress()
+{
+    if (IsBlockCompressed())
+    {
+        return true;
+    }
+
+    const uint8_t* Pixels = GetPixels();
+    const int32_t Bpp = static_cast<int32_t>(GetBytesPerPixel());
+    if (nullptr == Pixels || Bpp < 3 || mWidth <= 0 || mHeight <= 0)
+    {
+        return false;
+    }
+
+    // Opaque images get BC1 at 4 bits per texel, anything with alpha needs BC3
+    bool Opaque = true;
+    for (size_t i = 3; Bpp >= 4 && i < GetDataSize() && Opaque; i += Bpp)
+    {
+        Opaque = Pixels[i] == 255;
+    }
+
+    const RePiTextureFormat Format = GetColorSpaceFormat(Opaque ? RePiTextureFormat::eBC1_UNORM : RePiTextureFormat::eBC3_UNORM, IsSRGB());
+    const uint32_t BlocksWide = RePiBlockCodec::GetBlocksWide(mWidth);
+    const int32_t BlocksHigh = static_cast<int32_t>(RePiBlockCodec::GetBlocksWide(mHeight));
+    const uint32_t BlockBytes = RePiBlockCodec::GetBlockBytes(Format);
+    const int32_t Pitch = static_cast<int32_t>(GetPitch());
+
+    RePiPixelBuffer Blocks(static_cast<size_t>(BlocksWide) * BlocksHigh * BlockBytes);
+
+#pragma omp parallel for
+    for (int32_t by = 0; by < BlocksHigh; ++by)
+    {
+        uint8_t Texels[RePiBlockCodec::BlockTexels * 4];
+
+        for (uint32_t bx = 0; bx < BlocksWide; ++bx)
+        {
+            // Edge blocks repeat the last row and column
+            for (int32_t ty = 0; ty < 4; ++ty)
+            {
+                const int32_t y = RePiMath::min(by * 4 + ty, mHeight - 1);
+
+                for (int32_t tx = 0; tx < 4; ++tx)
+                {
+                    const int32_t x = RePiMath::min(static_cast<int32_t>(bx) * 4 + tx, mWidth - 1);
+                    const uint8_t* Src = Pixels + static_cast<size_t>(y) * Pitch + x * Bpp;
+                    uint8_t* Dst = &Texels[(ty * 4 + tx) * 4];
+
+                    Dst[0] = Src[0];
+                    Dst[1] = Src[1];
+                    Dst[2] = Src[2];
+                    Dst[3] = Bpp >= 4 ? Src[3] : 255;
+                }
+            }
+
+            RePiBlockCodec::EncodeBlock(Format, Texels, &Blocks[(static_cast<size_t>(by) * BlocksWide + bx) * BlockBytes]);
+        }
+    }
+
+    mBuffer = std::move(Blocks);
+    mMappedFile.reset();
+    mMappedOffset = 0;
+    mChannels = 4;
+    mBitsPerPixel = 32;
+    mFormat = Format;
+    mCacheKey = RePiBlockCodec::NewCacheKey();
+
+    return true;
+}
+
+float RePiImage::ComputePSNR(
+    const RePiImage& Reference,
+    const RePiImage& Test)
+{
+    if (Reference.mWidth != Test.mWidth || Reference.mHeight != Test.mHeight ||
+        Reference.mWidth <= 0 || Reference.mHeight <= 0)
+    {
+        RePiLog(RePiLogLevel::eWARNING, "Can't compare images of different sizes.");
+
+        return 0.f;
+    }
+
+    // GetPixel decodes blocks, so either image may be compressed
+    double SquaredError = 0.0;
+    for (int32_t y = 0; y < Reference.mHeight; ++y)
+    {
+        for (int32_t x = 0; x < Reference.mWidth; ++x)
+        {
+            const RePiColor a = Reference.GetPixel(RePiInt2(x, y));
+            const RePiColor b = Test.GetPixel(RePiInt2(x, y));
+            const int32_t dr = int32_t(a.r) - b.r;
+            const int32_t dg = int32_t(a.g) - b.g;
+            const int32_t db = int32_t(a.b) - b.b;
+
+            SquaredError += dr * dr + dg * dg + db * db;
+        }
+    }
+
+    const double MeanSquaredError = SquaredError / (3.0 * Reference.mWidth * Reference.mHeight);
+    if (MeanSquaredError <= 0.0)
+    {
+        return std::numeric_limits<float>::infinity();
+    }
+
+    return static_cast<float>(10.0 * std::log10(255.0 * 255.0 / MeanSquaredError));
+}
+
+void RePiImage::Decompress()
+{
+    if (!IsBlockCompressed())
+    {
+        return;
+    }
+
+    const uint8_t* Blocks = GetPixels();
+    const uint32_t BlocksWide = RePiBlockCodec::GetBlocksWide(mWidth);
+    const uint32_t BlockBytes = RePiBlockCodec::GetBlockBytes(mFormat);
+    const int32_t Pitch = mWidth * 4;
+
+    RePiPixelBuffer Decompressed(static_cast<size_t>(Pitch) * mHeight);
+    uint8_t Texels[RePiBlockCodec::BlockTexels * 4];
+
+    for (int32_t by = 0; by < mHeight; by += RePiBlockCodec::BlockDim)
+    {
+        for (int32_t bx = 0; bx < mWidth; bx += RePiBlockCodec::BlockDim)
+        {
+            const uint32_t BlockIndex = (by >> 2) * BlocksWide + (bx >> 2);
+            RePiBlockCodec::DecodeBlock(mFormat, Blocks + static_cast<size_t>(BlockIndex) * BlockBytes, Texels);
+
+            const int32_t Columns = RePiMath::min(static_cast<int32_t>(RePiBlockCodec::BlockDim), mWidth - bx);
+            const int32_t Rows = RePiMath::min(static_cast<int32_t>(RePiBlockCodec::BlockDim), mHeight - by);
+
+            for (int32_t y = 0; y < Rows; ++y)
+            {
+                memcpy(&Decompressed[static_cast<size_t>(by + y) * Pitch + bx * 4], &Texels[y * 16], Columns * 4);
+            }
+        }
+    }
+
+    mBuffer = std::move(Decompressed);
+    mMappedFile.reset();
+    mMappedOffset = 0;
+    mChannels = 4;
+    mBitsPerPixel = 32;
+    mFormat = GetColorSpaceFormat(RePiTextureFormat::eR8G8B8A8_UNORM, IsSRGB());
 }
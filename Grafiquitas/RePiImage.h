@@ -2,6 +2,8 @@
 
 #include "RePiBase.h"
 
+class RePiMappedFile;
+
 class RePiImage
 {
 public:
@@ -16,12 +18,20 @@ public:
         mHeight = Size.y;
         mBitsPerPixel = BitsPerPixel;
         mChannels = mBitsPerPixel >> 3;
+        mFormat = GetUnormFormat(mChannels);
+        mMappedFile.reset();
         mBuffer.resize(static_cast<size_t>(GetPitch() * mHeight));
     }
 
     bool Encode(
         const std::string& Filename = "");
 
+    bool EncodeToMemory(
+        std::vector<uint8_t>& Data) const;
+
+    bool EncodeBaked(
+        const std::string& Filename = "");
+
     bool Decode(
         const std::string& Filename = "");
 
@@ -55,15 +65,85 @@ public:
     void Clear(
         const RePiColor& Color = RePiColor::Black);
 
+    // Mapped or block compressed pixels are copied into the image's own buffer first
     void* GetData();
 
+    // Copies mapped or block compressed pixels into the image's own buffer so they can be written
+    bool MakeWritable();
+
+    bool IsMapped() const
+    {
+        return nullptr != mMappedFile;
+    }
+
+    RePiTextureFormat GetFormat() const
+    {
+        return mFormat;
+    }
+
+    bool IsBlockCompressed() const;
+
+    // The sRGB formats hold gamma encoded color, the bytes themselves are laid out the same
+    bool IsSRGB() const;
+
+    void SetSRGB(
+        const bool SRGB = true);
+
+    bool Compress();
+
+    // Peak signal to noise ratio of Test's RGB against Reference in dB, infinite when they match
+    static float ComputePSNR(
+        const RePiImage& Reference,
+        const RePiImage& Test);
+
+    // Raw read-only pixels, blocks for block compressed images
+    const uint8_t* GetPixels() const;
+
+    static RePiTextureFormat GetUnormFormat(
+        const int32_t Channels = 4);
+
+    static RePiTextureFormat GetColorSpaceFormat(
+        const RePiTextureFormat Format = RePiTextureFormat::eUNKNOWN,
+        const bool SRGB = false);
+
+private:
+    bool DecodeBMP(
+        const std::shared_ptr<RePiMappedFile>& MappedFile,
+        const std::string& Filename = "");
+
+    bool DecodeBaked(
+        const std::shared_ptr<RePiMappedFile>& MappedFile,
+        const std::string& Filename = "");
+
+    bool DecodeTGA(
+        const std::shared_ptr<RePiMappedFile>& MappedFile,
+        const std::string& Filename = "");
+
+    bool DecodeDDS(
+        const std::shared_ptr<RePiMappedFile>& MappedFile,
+        const std::string& Filename = "");
+
+    size_t GetDataSize() const;
+
+    void Decompress();
+
+    uint8_t* GetWritablePixels();
+
 protected:
     int32_t mChannels;
     RePiInt2 mSize;
     int32_t mWidth;
     int32_t mHeight;
     int32_t mBitsPerPixel;
-    std::vector<uint8_t> mBuffer;
+    RePiPixelBuffer mBuffer;
+    RePiTextureFormat mFormat;
+
+    // Identifies this image's blocks in the per-thread decoded block cache
+    uint32_t mCacheKey;
+
+    // Read-only view of the source file, used instead of mBuffer while the pixels are untouched
+    std::shared_ptr<RePiMappedFile> mMappedFile;
+    size_t mMappedOffset;
 
 #pragma pack(push, 1)
     struct BMPHeader
@@ -121,5 +201,82 @@ protected:
         uint32_t BlueMask;          // Bit mask for the blue channel
         uint32_t AlphaMask;         // Bit mask for the alpha channel
     };
+
+    struct BakedHeader
+    {
+        BakedHeader()
+            : Signature(0u)
+            , Width(0)
+            , Height(0)
+            , BitsPerPixel(0u)
+            , OffsetData(0u)
+        {
+        };
+
+        uint32_t Signature;         // File type, should be "RPTX" (0x58545052)
+        int32_t Width;              // Width of the image in pixels
+        int32_t Height;             // Height of the image in pixels, rows stored top-to-bottom
+        uint32_t BitsPerPixel;      // Bits per pixel of the in-memory layout
+        uint32_t Format;            // RePiTextureFormat of the stored data
+        uint32_t OffsetData;        // Offset to the pixel data, 64 byte aligned
+    };
+
+    struct TGAHeader
+    {
+        TGAHeader()
+        {
+            memset(this, 0, sizeof(TGAHeader));
+        };
+
+        uint8_t IdLength;           // Size of the image id field that follows the header
+        uint8_t ColorMapType;       // 0 = no color map
+        uint8_t ImageType;          // 2 = truecolor, 3 = grayscale, +8 = RLE compressed
+        uint16_t ColorMapFirst;     // First color map entry
+        uint16_t ColorMapLength;    // Number of color map entries
+        uint8_t ColorMapEntrySize;  // Bits per color map entry
+        uint16_t XOrigin;
+        uint16_t YOrigin;
+        uint16_t Width;             // Width of the image in pixels
+        uint16_t Height;            // Height of the image in pixels
+        uint8_t BitsPerPixel;       // Bits per pixel (8, 24 or 32)
+        uint8_t Descriptor;         // Bit 5 set = rows stored top-to-bottom
+    };
+
+    struct DDSHeader
+    {
+        DDSHeader()
+        {
+            memset(this, 0, sizeof(DDSHeader));
+        };
+
+        uint32_t Signature;         // File type, should be "DDS " (0x20534444)
+        uint32_t HeaderSize;        // Size of the header without the signature, must be 124
+        uint32_t Flags;
+        uint32_t Height;            // Height of the top mip in pixels
+        uint32_t Width;             // Width of the top mip in pixels
+        uint32_t PitchOrLinearSize;
+        uint32_t Depth;
+        uint32_t MipMapCount;
+        uint32_t Unused[11];
+        uint32_t FormatSize;        // Size of the pixel format, must be 32
+        uint32_t FormatFlags;       // 0x4 = FourCC, 0x40 = RGB, 0x1 = alpha mask valid
+        uint32_t FourCC;            // DXT1, DXT3, DXT5 or DX10
+        uint32_t RGBBitCount;       // Bits per pixel of uncompressed data
+        uint32_t RedMask;           // Bit mask for the red channel
+        uint32_t GreenMask;         // Bit mask for the green channel
+        uint32_t BlueMask;          // Bit mask for the blue channel
+        uint32_t AlphaMask;         // Bit mask for the alpha channel
+        uint32_t Caps[4];
+        uint32_t Reserved;
+    };
+
+    struct DDSHeaderDX10
+    {
+        uint32_t DXGIFormat;        // DXGI_FORMAT of the data
+        uint32_t ResourceDimension;
+        uint32_t MiscFlags;
+        uint32_t ArraySize;
+        uint32_t MiscFlags2;
+    };
 #pragma pack(pop)
 };
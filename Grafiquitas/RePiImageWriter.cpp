@@ -0,0 +1,270 @@
+#include "RePiImageWriter.h"
+
+RePiImageWriter::RePiImageWriter() :
+    mBusy(false),
+    mQuit(false),
+    mStreamFormat(RePiStreamFormat::eY4M),
+    mStreamSize(RePiInt2::ZERO),
+    mStreamOpen(false)
+{
+    mWorker = std::thread(&RePiImageWriter::WorkerLoop, this);
+}
+
+RePiImageWriter::~RePiImageWriter()
+{
+    {
+        std::lock_guard<std::mutex> Lock(mMutex);
+        mQuit = true;
+    }
+    mJobAvailable.notify_all();
+
+    // The worker drains the queue before leaving
+    if (mWorker.joinable())
+    {
+        mWorker.join();
+    }
+
+    mStream.close();
+}
+
+void RePiImageWriter::Save(
+    RePiImage&& Snapshot,
+    const std::string& Filename)
+{
+    Enqueue({ eFILE, std::move(Snapshot), Filename });
+}
+
+void RePiImageWriter::SaveSequence(
+    RePiImage&& Snapshot,
+    const std::string& Prefix)
+{
+    uint32_t Frame = 0;
+    {
+        std::lock_guard<std::mutex> Lock(mMutex);
+        Frame = mSequenceFrames[Prefix]++;
+    }
+
+    std::string Number = std::to_string(Frame);
+    Number.insert(0, Number.size() < 6 ? 6 - Number.size() : 0, '0');
+
+    Enqueue({ eFILE, std::move(Snapshot), Prefix + "_" + Number + ".bmp" });
+}
+
+bool RePiImageWriter::OpenStream(
+    const std::string& Filename,
+    const RePiInt2& Size,
+    const RePiStreamFormat Format,
+    const uint32_t FrameRate)
+{
+    CloseStream();
+
+    if (Size.x <= 0 || Size.y <= 0)
+    {
+        RePiLog(RePiLogLevel::eWARNING, "Invalid stream size: " + Filename);
+
+        return false;
+    }
+
+    mStream.open(Filename, std::ios::binary);
+    if (!mStream)
+    {
+        RePiLog(RePiLogLevel::eWARNING, "Unable to open stream for writing: " + Filename);
+
+        return false;
+    }
+
+    mStreamFormat = Format;
+    mStreamSize = Size;
+
+    if (Format == RePiStreamFormat::eY4M)
+    {
+        const std::string Header = "YUV4MPEG2 W" + std::to_string(Size.x) + " H" + std::to_string(Size.y) +
+                                   " F" + std::to_string(FrameRate) + ":1 Ip A1:1 C444\n";
+        mStream.write(Header.data(), Header.size());
+    }
+
+    mStreamOpen = true;
+
+    return true;
+}
+
+void RePiImageWriter::WriteStreamFrame(
+    RePiImage&& Snapshot)
+{
+    if (!mStreamOpen)
+    {
+        RePiLog(RePiLogLevel::eWARNING, "No stream is open for writing frames.");
+
+        return;
+    }
+
+    Enqueue({ eSTREAM_FRAME, std::move(Snapshot), "" });
+}
+
+void RePiImageWriter::CloseStream()
+{
+    Flush();
+
+    if (mStreamOpen.exchange(false))
+    {
+        mStream.close();
+    }
+}
+
+void RePiImageWriter::Flush()
+{
+    std::unique_lock<std::mutex> Lock(mMutex);
+    mJobDone.wait(Lock, [this]() { return mJobs.empty() && !mBusy; });
+}
+
+void RePiImageWriter::Enqueue(
+    RePiWriteJob&& Job)
+{
+    {
+        std::unique_lock<std::mutex> Lock(mMutex);
+        mJobDone.wait(Lock, [this]() { return mJobs.size() < MaxPendingJobs; });
+        mJobs.push_back(std::move(Job));
+    }
+    mJobAvailable.notify_one();
+}
+
+void RePiImageWriter::WorkerLoop()
+{
+    while (true)
+    {
+        RePiWriteJob Job;
+        {
+            std::unique_lock<std::mutex> Lock(mMutex);
+            mJobAvailable.wait(Lock, [this]() { return mQuit || !mJobs.empty(); });
+
+            if (mJobs.empty())
+            {
+                return;
+            }
+
+            Job = std::move(mJobs.front());
+            mJobs.pop_front();
+            mBusy = true;
+        }
+
+        // Wake producers waiting for a free slot
+        mJobDone.notify_all();
+
+        if (Job.Type == eFILE)
+        {
+            WriteFile(Job);
+        }
+        else
+        {
+            WriteFrame(Job);
+        }
+
+        {
+            std::lock_guard<std::mutex> Lock(mMutex);
+            mBusy = false;
+        }
+        mJobDone.notify_all();
+    }
+}
+
+void RePiImageWriter::WriteFile(
+    RePiWriteJob& Job)
+{
+    if (!Job.Image.EncodeToMemory(mEncodeBuffer))
+    {
+        return;
+    }
+
+    std::ofstream File(Job.Filename, std::ios::binary);
+    if (!File)
+    {
+        RePiLog(RePiLogLevel::eWARNING, "Unable to open file for writing: " + Job.Filename);
+
+        return;
+    }
+
+    File.write(reinterpret_cast<const char*>(mEncodeBuffer.data()), mEncodeBuffer.size());
+}
+
+void RePiImageWriter::WriteFrame(
+    RePiWriteJob& Job)
+{
+    RePiImage& Image = Job.Image;
+    const int32_t Width = Image.GetWidth();
+    const int32_t Height = Image.GetHeight();
+
+    if (Width != mStreamSize.x || Height != mStreamSize.y)
+    {
+        RePiLog(RePiLogLevel::eWARNING, "Stream frame size does not match the stream.");
+
+        return;
+    }
+
+    // The snapshot may still be mapped or block compressed
+    Image.MakeWritable();
+    const uint8_t* Pixels = static_cast<const uint8_t*>(Image.GetData());
+    const int32_t Bpp = static_cast<int32_t>(Image.GetBytesPerPixel());
+    if (nullptr == Pixels || Bpp < 3)
+    {
+        RePiLog(RePiLogLevel::eWARNING, "Stream frames need at least three channels.");
+
+        return;
+    }
+
+    const size_t PlaneSize = static_cast<size_t>(Width) * Height;
+
+    if (mStreamFormat == RePiStreamFormat::eY4M)
+    {
+        static const char FrameTag[] = "FRAME\n";
+        const size_t HeaderSize = sizeof(FrameTag) - 1;
+
+        mEncodeBuffer.resize(HeaderSize + PlaneSize * 3);
+        std::memcpy(mEncodeBuffer.data(), FrameTag, HeaderSize);
+
+        uint8_t* PlaneY = mEncodeBuffer.data() + HeaderSize;
+        uint8_t* PlaneU = PlaneY + PlaneSize;
+        uint8_t* PlaneV = PlaneU + PlaneSize;
+
+        // BT.601 limited range, converted serially so the render threads keep every core
+        for (int32_t y = 0; y < Height; ++y)
+        {
+            const uint8_t* Src = Pixels + static_cast<size_t>(y) * Width * Bpp;
+            const size_t Row = static_cast<size_t>(y) * Width;
+
+            for (int32_t x = 0; x < Width; ++x, Src += Bpp)
+            {
+                const int32_t r = Src[0];
+                const int32_t g = Src[1];
+                const int32_t b = Src[2];
+
+                PlaneY[Row + x] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+                PlaneU[Row + x] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+                PlaneV[Row + x] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+            }
+        }
+    }
+    else
+    {
+        const std::string Header = "P6\n" + std::to_string(Width) + " " + std::to_string(Height) + "\n255\n";
+
+        mEncodeBuffer.resize(Header.size() + PlaneSize * 3);
+        std::memcpy(mEncodeBuffer.data(), Header.data(), Header.size());
+
+        uint8_t* Dst = mEncodeBuffer.data() + Header.size();
+
+        for (int32_t y = 0; y < Height; ++y)
+        {
+            const uint8_t* Src = Pixels + static_cast<size_t>(y) * Width * Bpp;
+            uint8_t* DstRow = Dst + static_cast<size_t>(y) * Width * 3;
+
+            for (int32_t x = 0; x < Width; ++x, Src += Bpp, DstRow += 3)
+            {
+                DstRow[0] = Src[0];
+                DstRow[1] = Src[1];
+                DstRow[2] = Src[2];
+            }
+        }
+    }
+
+    mStream.write(reinterpret_cast<const char*>(mEncodeBuffer.data()), mEncodeBuffer.size());
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "RePiBase.h"
+#include "RePiModule.h"
+#include "RePiImage.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+enum RePiStreamFormat
+{
+    ePPM = 0,
+    eY4M
+};
+
+class RePiImageWriter : public RePiModule<RePiImageWriter, std::function<void()>>
+{
+public:
+    RePiImageWriter();
+
+    virtual ~RePiImageWriter();
+
+    // Encodes the snapshot to a BMP on the writer thread
+    void Save(
+        RePiImage&& Snapshot,
+        const std::string& Filename = "");
+
+    // Saves the snapshot as the next frame of Prefix_000000.bmp, Prefix_000001.bmp...
+    void SaveSequence(
+        RePiImage&& Snapshot,
+        const std::string& Prefix = "");
+
+    bool OpenStream(
+        const std::string& Filename = "",
+        const RePiInt2& Size = RePiInt2::ZERO,
+        const RePiStreamFormat Format = RePiStreamFormat::eY4M,
+        const uint32_t FrameRate = 30);
+
+    void WriteStreamFrame(
+        RePiImage&& Snapshot);
+
+    void CloseStream();
+
+    bool IsStreamOpen() const
+    {
+        return mStreamOpen.load();
+    }
+
+    // Blocks until every queued image has been written
+    void Flush();
+
+private:
+    enum RePiWriteJobType
+    {
+        eFILE = 0,
+        eSTREAM_FRAME
+    };
+
+    struct RePiWriteJob
+    {
+        RePiWriteJobType Type = eFILE;
+        RePiImage Image;
+        std::string Filename;
+    };
+
+    void Enqueue(
+        RePiWriteJob&& Job);
+
+    void WorkerLoop();
+
+    void WriteFile(
+        RePiWriteJob& Job);
+
+    void WriteFrame(
+        RePiWriteJob& Job);
+
+private:
+    // Bounds the memory held by snapshots when the disk can't keep up
+    static const size_t MaxPendingJobs = 8;
+
+    std::deque<RePiWriteJob> mJobs;
+
+    std::mutex mMutex;
+
+    std::condition_variable mJobAvailable;
+
+    std::condition_variable mJobDone;
+
+    std::thread mWorker;
+
+    bool mBusy;
+
+    bool mQuit;
+
+    std::map<std::string, uint32_t> mSequenceFrames;
+
+    std::ofstream mStream;
+
+    RePiStreamFormat mStreamFormat;
+
+    RePiInt2 mStreamSize;
+
+    // The worker writes to mStream, other threads only check this flag
+    std::atomic<bool> mStreamOpen;
+
+    std::vector<uint8_t> mEncodeBuffer;
+};
@@ -0,0 +1,252 @@
+#include "RePiLightGrid.h"
+
+#include "RePi3DModel.h"
+
+RePiLightGrid::RePiLightGrid(
+    const int32_t TileSize,
+    const int32_t DepthSlices) :
+    mTileSize(RePiMath::max(TileSize, 1)),
+    mDepthSlices(RePiMath::max(DepthSlices, 1)),
+    mSize(RePiInt2::ZERO),
+    mTiles(RePiInt2::ZERO),
+    mNearZ(1.f),
+    mFarZ(1.f),
+    mSliceScale(0.f),
+    mView(RePiMatrix::IDENTITY),
+    mInverseProjection(RePiMatrix::IDENTITY),
+    mClusterOffsets(1, 0)
+{
+}
+
+void RePiLightGrid::Build(
+    const std::vector<RePiPointLight>& LightList,
+    const RePiMatrix& View,
+    const RePiMatrix& Projection,
+    const RePiInt2& Size,
+    const float NearZ,
+    const float FarZ)
+{
+    mSize = Size;
+    mTiles = RePiInt2((Size.x + mTileSize - 1) / mTileSize, (Size.y + mTileSize - 1) / mTileSize);
+
+    // A zero near plane would put every slice boundary at the camera
+    mNearZ = RePiMath::max(NearZ, 0.001f);
+    mFarZ = RePiMath::max(FarZ, mNearZ * 2.f);
+    mSliceScale = float(mDepthSlices) / std::log(mFarZ / mNearZ);
+
+    mView = View;
+    mInverseProjection = Projection.inverseFast();
+
+    const size_t ClusterCount = static_cast<size_t>(mTiles.x) * mTiles.y * mDepthSlices;
+    mClusterOffsets.assign(ClusterCount + 1, 0);
+    mLightIndices.clear();
+    mViewLights.clear();
+
+    if (mSize.x < 2 || mSize.y < 2)
+    {
+        return;
+    }
+
+    struct RePiClusterRange
+    {
+        RePiInt2 MinTile;
+        RePiInt2 MaxTile;
+        int32_t MinSlice;
+        int32_t MaxSlice;
+    };
+
+    std::vector<RePiClusterRange> Ranges;
+    Ranges.reserve(LightList.size());
+    mViewLights.reserve(LightList.size());
+
+    for (const RePiPointLight& Light : LightList)
+    {
+        if (Light.radius <= 0.f || Light.intensity <= 0.f)
+        {
+            continue;
+        }
+
+        const RePiFloat4 Center4 = View.transformVector4(RePiFloat4(Light.position, 1.f));
+        const RePiFloat3 Center(Center4.x, Center4.y, Center4.z);
+        const float Radius = Light.radius;
+
+        const float MinZ = RePiMath::max(Center.z - Radius, mNearZ);
+        const float MaxZ = RePiMath::min(Center.z + Radius, mFarZ);
+        if (MinZ > MaxZ)
+        {
+            continue;
+        }
+
+        // The sphere's box, cut at the near plane, is in front of the camera so its corners bound the projection
+        RePiFloat2 MinNdc(1.f, 1.f);
+        RePiFloat2 MaxNdc(-1.f, -1.f);
+        for (int32_t Corner = 0; Corner < 8; ++Corner)
+        {
+            const RePiFloat4 Clip = Projection.transformVector4(RePiFloat4(
+                Center.x + (Corner & 1 ? Radius : -Radius),
+                Center.y + (Corner & 2 ? Radius : -Radius),
+                Corner & 4 ? MaxZ : MinZ,
+                1.f));
+
+            const float x = Clip.x / Clip.w;
+            const float y = Clip.y / Clip.w;
+            MinNdc = RePiFloat2(RePiMath::min(MinNdc.x, x), RePiMath::min(MinNdc.y, y));
+            MaxNdc = RePiFloat2(RePiMath::max(MaxNdc.x, x), RePiMath::max(MaxNdc.y, y));
+        }
+
+        if (MinNdc.x > 1.f || MaxNdc.x < -1.f || MinNdc.y > 1.f || MaxNdc.y < -1.f)
+        {
+            continue;
+        }
+
+        // y flips, so the top left corner comes from the largest NDC y
+        const RePiFloat2 Size(float(mSize.x), float(mSize.y));
+        const RePiFloat2 Min = RePiRasterizerStage::NdcToScreen(RePiFloat2(RePiMath::max(MinNdc.x, -1.f), RePiMath::min(MaxNdc.y, 1.f)), Size);
+        const RePiFloat2 Max = RePiRasterizerStage::NdcToScreen(RePiFloat2(RePiMath::min(MaxNdc.x, 1.f), RePiMath::max(MinNdc.y, -1.f)), Size);
+
+        RePiClusterRange Range;
+        Range.MinTile = RePiInt2(int32_t(Min.x) / mTileSize, int32_t(Min.y) / mTileSize);
+        Range.MaxTile = RePiInt2(RePiMath::min(int32_t(Max.x) / mTileSize, mTiles.x - 1), RePiMath::min(int32_t(Max.y) / mTileSize, mTiles.y - 1));
+        Range.MinSlice = GetDepthSlice(MinZ);
+        Range.MaxSlice = GetDepthSlice(MaxZ);
+        Ranges.push_back(Range);
+
+        RePiViewLight ViewLight;
+        ViewLight.Position = Center;
+        ViewLight.RadiusSquared = Radius * Radius;
+        ViewLight.Color = Light.color * Light.intensity;
+        mViewLights.push_back(ViewLight);
+    }
+
+    // Count, prefix sum, then fill, so every cluster's list is contiguous
+    auto ForEachCluster = [this](const RePiClusterRange& Range, auto&& Function)
+    {
+        for (int32_t Slice = Range.MinSlice; Slice <= Range.MaxSlice; ++Slice)
+        {
+            for (int32_t ty = Range.MinTile.y; ty <= Range.MaxTile.y; ++ty)
+            {
+                for (int32_t tx = Range.MinTile.x; tx <= Range.MaxTile.x; ++tx)
+                {
+                    Function((static_cast<size_t>(Slice) * mTiles.y + ty) * mTiles.x + tx);
+                }
+            }
+        }
+    };
+
+    for (const RePiClusterRange& Range : Ranges)
+    {
+        ForEachCluster(Range, [this](const size_t Cluster) { ++mClusterOffsets[Cluster + 1]; });
+    }
+
+    for (size_t Cluster = 0; Cluster < ClusterCount; ++Cluster)
+    {
+        mClusterOffsets[Cluster + 1] += mClusterOffsets[Cluster];
+    }
+
+    mLightIndices.resize(mClusterOffsets[ClusterCount]);
+    std::vector<uint32_t> Cursor(mClusterOffsets.begin(), mClusterOffsets.end() - 1);
+
+    for (uint32_t Light = 0; Light < Ranges.size(); ++Light)
+    {
+        ForEachCluster(Ranges[Light], [this, &Cursor, Light](const size_t Cluster) { mLightIndices[Cursor[Cluster]++] = Light; });
+    }
+}
+
+RePiLinearColor RePiLightGrid::ComputeLighting(
+    const RePiVertex& V) const
+{
+    if (mViewLights.empty() || mSize.x < 2 || mSize.y < 2)
+    {
+        return RePiLinearColor::Black;
+    }
+
+    const RePiInt2 xy(
+        RePiMath::clamp(int32_t(V.Position.x), 0, mSize.x - 1),
+        RePiMath::clamp(int32_t(V.Position.y), 0, mSize.y - 1));
+
+    const RePiFloat3 Position = GetViewPosition(xy, V.Position.z);
+    const RePiFloat3 Normal = mView.transformVector(V.Normal).getSafeNormal();
+
+    const auto Lights = GetClusterLights(GetClusterIndex(xy, Position.z));
+
+    RePiFloat3 Sum(0.f, 0.f, 0.f);
+    for (uint32_t i = 0; i < Lights.second; ++i)
+    {
+        AccumulateLight(mViewLights[Lights.first[i]], Position, Normal, Sum);
+    }
+
+#if defined(REPI_VALIDATE_LIGHT_GRID)
+    // Lights culled from the cluster must not reach the pixel
+    RePiFloat3 Reference(0.f, 0.f, 0.f);
+    for (const RePiViewLight& Light : mViewLights)
+    {
+        AccumulateLight(Light, Position, Normal, Reference);
+    }
+
+    const RePiFloat3 Error = Reference - Sum;
+    if (RePiMath::max(RePiMath::max(std::abs(Error.x), std::abs(Error.y)), std::abs(Error.z)) > 1e-3f * RePiMath::max(1.f, Reference.size()))
+    {
+        RePiLog(RePiLogLevel::eWARNING, "Light grid misses lights at pixel " + std::to_string(xy.x) + ", " + std::to_string(xy.y));
+    }
+#endif
+
+    return RePiLinearColor(Sum.x, Sum.y, Sum.z, 1.f);
+}
+
+void RePiLightGrid::AccumulateLight(
+    const RePiViewLight& Light,
+    const RePiFloat3& Position,
+    const RePiFloat3& Normal,
+    RePiFloat3& Sum)
+{
+    const RePiFloat3 ToLight = Light.Position - Position;
+    const float DistanceSquared = ToLight.sizeSquared();
+    if (DistanceSquared >= Light.RadiusSquared || DistanceSquared <= 0.f)
+    {
+        return;
+    }
+
+    const float NdotL = RePiFloat3::dot(Normal, ToLight) / std::sqrt(DistanceSquared);
+    if (NdotL <= 0.f)
+    {
+        return;
+    }
+
+    // Smooth window so the light fades to zero exactly at its radius
+    const float Window = 1.f - DistanceSquared / Light.RadiusSquared;
+    const float Factor = NdotL * Window * Window;
+
+    Sum = Sum + RePiFloat3(Light.Color.r, Light.Color.g, Light.Color.b) * Factor;
+}
+
+uint32_t RePiLightGrid::GetClusterIndex(
+    const RePiInt2& xy,
+    const float ViewDepth) const
+{
+    const int32_t tx = RePiMath::clamp(xy.x / mTileSize, 0, mTiles.x - 1);
+    const int32_t ty = RePiMath::clamp(xy.y / mTileSize, 0, mTiles.y - 1);
+
+    return static_cast<uint32_t>((GetDepthSlice(ViewDepth) * mTiles.y + ty) * mTiles.x + tx);
+}
+
+int32_t RePiLightGrid::GetDepthSlice(
+    const float ViewDepth) const
+{
+    if (ViewDepth <= mNearZ)
+    {
+        return 0;
+    }
+
+    return RePiMath::clamp(int32_t(std::log(ViewDepth / mNearZ) * mSliceScale), 0, mDepthSlices - 1);
+}
+
+RePiFloat3 RePiLightGrid::GetViewPosition(
+    const RePiInt2& xy,
+    const float Depth) const
+{
+    const RePiFloat2 Ndc = RePiRasterizerStage::ScreenToNdc(RePiFloat2(float(xy.x), float(xy.y)), RePiFloat2(float(mSize.x), float(mSize.y)));
+
+    const RePiFloat4 View = mInverseProjection.transformVector4(RePiFloat4(Ndc.x, Ndc.y, Depth, 1.f));
+
+    return RePiFloat3(View.x, View.y, View.z) / View.w;
+}
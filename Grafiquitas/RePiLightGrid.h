@@ -0,0 +1,89 @@
+#pragma once
+
+#include "RePiBase.h"
+#include "RePiRasterizerStage.h"
+
+struct RePiVertex;
+
+// Screen tiles split into exponential view depth slices, each cluster lists the point lights that can reach it
+class RePiLightGrid
+{
+public:
+    RePiLightGrid(
+        const int32_t TileSize = 16,
+        const int32_t DepthSlices = 16);
+
+    ~RePiLightGrid() = default;
+
+    // Bins every light into the clusters its view space bounds overlap
+    void Build(
+        const std::vector<RePiPointLight>& LightList,
+        const RePiMatrix& View,
+        const RePiMatrix& Projection,
+        const RePiInt2& Size,
+        const float NearZ,
+        const float FarZ);
+
+    // Diffuse light reaching a rasterized pixel, summed over the lights of its cluster only
+    RePiLinearColor ComputeLighting(
+        const RePiVertex& V) const;
+
+    uint32_t GetClusterIndex(
+        const RePiInt2& xy,
+        const float ViewDepth) const;
+
+    // Indices into the light list for one cluster
+    std::pair<const uint32_t*, uint32_t> GetClusterLights(
+        const uint32_t Cluster) const
+    {
+        return { mLightIndices.data() + mClusterOffsets[Cluster], mClusterOffsets[Cluster + 1] - mClusterOffsets[Cluster] };
+    }
+
+    uint32_t GetLightCount() const
+    {
+        return static_cast<uint32_t>(mViewLights.size());
+    }
+
+private:
+    int32_t GetDepthSlice(
+        const float ViewDepth) const;
+
+    RePiFloat3 GetViewPosition(
+        const RePiInt2& xy,
+        const float Depth) const;
+
+private:
+    struct RePiViewLight
+    {
+        RePiFloat3 Position;
+        float RadiusSquared;
+        RePiLinearColor Color;
+    };
+
+    static void AccumulateLight(
+        const RePiViewLight& Light,
+        const RePiFloat3& Position,
+        const RePiFloat3& Normal,
+        RePiFloat3& Sum);
+
+    const int32_t mTileSize;
+    const int32_t mDepthSlices;
+
+    RePiInt2 mSize;
+    RePiInt2 mTiles;
+
+    float mNearZ;
+    float mFarZ;
+
+    // Slice = log(z / near) * mSliceScale
+    float mSliceScale;
+
+    RePiMatrix mView;
+    RePiMatrix mInverseProjection;
+
+    std::vector<RePiViewLight> mViewLights;
+
+    // Prefix sums, cluster i owns [mClusterOffsets[i], mClusterOffsets[i + 1])
+    std::vector<uint32_t> mClusterOffsets;
+    std::vector<uint32_t> mLightIndices;
+};
@@ -0,0 +1,93 @@
+#include "RePiMappedFile.h"
+
+RePiMappedFile::RePiMappedFile()
+    : mFile(INVALID_HANDLE_VALUE)
+    , mMapping(nullptr)
+    , mData(nullptr)
+    , mSize(0)
+{
+}
+
+RePiMappedFile::~RePiMappedFile()
+{
+    Close();
+}
+
+bool RePiMappedFile::Open(
+    const std::string& Filename)
+{
+    Close();
+
+    mFile = CreateFileA(Filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (mFile == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER FileSize{};
+    if (!GetFileSizeEx(mFile, &FileSize) || FileSize.QuadPart == 0)
+    {
+        Close();
+
+        return false;
+    }
+
+    // Pages are only brought in when the pixels are first touched
+    mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (nullptr == mMapping)
+    {
+        Close();
+
+        return false;
+    }
+
+    mData = static_cast<const uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+    if (nullptr == mData)
+    {
+        Close();
+
+        return false;
+    }
+
+    mSize = static_cast<size_t>(FileSize.QuadPart);
+
+    return true;
+}
+
+void RePiMappedFile::Close()
+{
+    if (nullptr != mData)
+    {
+        UnmapViewOfFile(mData);
+        mData = nullptr;
+    }
+
+    if (nullptr != mMapping)
+    {
+        CloseHandle(mMapping);
+        mMapping = nullptr;
+    }
+
+    if (mFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(mFile);
+        mFile = INVALID_HANDLE_VALUE;
+    }
+
+    mSize = 0;
+}
+
+bool RePiMappedFile::IsOpen() const
+{
+    return nullptr != mData;
+}
+
+const uint8_t* RePiMappedFile::GetData() const
+{
+    return mData;
+}
+
+size_t RePiMappedFile::GetSize() const
+{
+    return mSize;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "RePiBase.h"
+
+class RePiMappedFile
+{
+public:
+    RePiMappedFile();
+
+    ~RePiMappedFile();
+
+    RePiMappedFile(const RePiMappedFile&) = delete;
+
+    RePiMappedFile& operator=(const RePiMappedFile&) = delete;
+
+    bool Open(
+        const std::string& Filename = "");
+
+    void Close();
+
+    bool IsOpen() const;
+
+    const uint8_t* GetData() const;
+
+    size_t GetSize() const;
+
+private:
+    HANDLE mFile;
+
+    HANDLE mMapping;
+
+    const uint8_t* mData;
+
+    size_t mSize;
+};
@@ -3,9 +3,58 @@
 #include "RePiTexture.h"
 
 void RePiMaterial::AddImageResource(
-    const std::weak_ptr<RePiTexture>& Image)
+    const std::weak_ptr<RePiTexture>& Image,
+    const RePiSamplerState& SamplerState)
 {
     mImageList.push_back(Image);
+    mSamplerStateList.push_back(SamplerState);
+}
+
+void RePiMaterial::SetImageResource(
+    const uint32_t Slot,
+    const std::weak_ptr<RePiTexture>& Image,
+    const RePiSamplerState& SamplerState)
+{
+    if (Slot >= mImageList.size())
+    {
+        mImageList.resize(Slot + 1);
+        mSamplerStateList.resize(Slot + 1);
+    }
+
+    mImageList[Slot] = Image;
+    mSamplerStateList[Slot] = SamplerState;
+}
+
+void RePiMaterial::ResolveSamplers(
+    const RePiSampleFilter MaxFilter)
+{
+    mSamplerList.resize(mImageList.size());
+
+    for (size_t i = 0; i < mImageList.size(); ++i)
+    {
+        mSamplerList[i].Bind(mImageList[i], mSamplerStateList[i], MaxFilter);
+    }
+}
+
+void RePiMaterial::ReleaseSamplers()
+{
+    for (auto& Sampler : mSamplerList)
+    {
+        Sampler.Unbind();
+    }
+}
+
+const RePiSampler& RePiMaterial::GetSampler(
+    const uint32_t Slot) const
+{
+    static const RePiSampler Unbound;
+
+    if (Slot >= mSamplerList.size())
+    {
+        return Unbound;
+    }
+
+    return mSamplerList[Slot];
 }
 
 /*void RePiMaterial::BindToCommandBuffer(const std::weak_ptr<RePiCommandBuffer>& CommandBuffer)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "RePiMetadata.h"
+#include "RePiSampler.h"
 
 class RePiTexture;
 
@@ -11,8 +12,29 @@ public:
 
     ~RePiMaterial() = default;
 
-    void AddImageResource(const std::weak_ptr<RePiTexture>& Image);
+    void AddImageResource(
+        const std::weak_ptr<RePiTexture>& Image,
+        const RePiSamplerState& SamplerState = RePiSamplerState());
+
+    // Places the image at a fixed slot, slots skipped on the way stay unbound
+    void SetImageResource(
+        const uint32_t Slot,
+        const std::weak_ptr<RePiTexture>& Image,
+        const RePiSamplerState& SamplerState = RePiSamplerState());
+
+    // Binds every slot once per draw, MaxFilter comes from the rasteriser settings
+    void ResolveSamplers(
+        const RePiSampleFilter MaxFilter = RePiSampleFilter::eFILTER_ANISOTROPIC);
+
+    void ReleaseSamplers();
+
+    const RePiSampler& GetSampler(
+        const uint32_t Slot = 0) const;
 
     //void BindToCommandBuffer(const std::weak_ptr<RePiCommandBuffer>& CommandBuffer);
     std::vector<std::weak_ptr<RePiTexture>> mImageList;
+    std::vector<RePiSamplerState> mSamplerStateList;
+
+private:
+    std::vector<RePiSampler> mSamplerList;
 };
@@ -3,6 +3,28 @@
 #include "RePi3DModel.h"
 #include "RePiMaterial.h"
 #include "RePiTexture.h"
+#include "RePiTemporalReprojection.h"
+#include "RePiCheckerboard.h"
+#include "RePiShadingRateImage.h"
+#include "RePiGBuffer.h"
+#include "RePiVisibilityBuffer.h"
+
+// Coarse pixels shaded by the triangle half this thread is drawing, keyed by the coarse pixel's left column
+struct RePiCoarseShadingCache
+{
+    struct Entry
+    {
+        uint32_t Stamp = 0;
+        int32_t AnchorY = 0;
+        RePiLinearColor Color;
+    };
+
+    // Bumped per triangle half, so stale entries never need clearing
+    uint32_t Stamp = 0;
+    std::vector<Entry> Entries;
+};
+
+static thread_local RePiCoarseShadingCache g_CoarseShadingCache;
 
 void RePiRasterizerStage::BindTriangleList(
     const std::weak_ptr<std::vector<RePiTriangle>>& TriangleList)
@@ -58,6 +80,36 @@ void RePiRasterizerStage::BindPixelShader(
     mPixelShader = PixelShader;
 }
 
+void RePiRasterizerStage::BindTemporal(
+    const std::weak_ptr<RePiTemporalReprojection>& Temporal)
+{
+    mTemporal = Temporal;
+}
+
+void RePiRasterizerStage::BindCheckerboard(
+    const std::weak_ptr<RePiCheckerboard>& Checkerboard)
+{
+    mCheckerboard = Checkerboard;
+}
+
+void RePiRasterizerStage::BindShadingRate(
+    const std::weak_ptr<RePiShadingRateImage>& ShadingRate)
+{
+    mShadingRate = ShadingRate;
+}
+
+void RePiRasterizerStage::BindGBuffer(
+    const std::weak_ptr<RePiGBuffer>& GBuffer)
+{
+    mGBuffer = GBuffer;
+}
+
+void RePiRasterizerStage::BindVisibilityBuffer(
+    const std::weak_ptr<RePiVisibilityBuffer>& VisibilityBuffer)
+{
+    mVisibilityBuffer = VisibilityBuffer;
+}
+
 void RePiRasterizerStage::Execute()
 {
     mSize = RePiFloat2::ZERO;
@@ -77,47 +129,87 @@ void RePiRasterizerStage::Execute()
         mSize = pTarget->GetSize();
     }
 
-    if (mPixelShader)
+    if (!mPixelShader)
     {
         if (auto pTriangleList = mTriangleList.lock())
         {
-#pragma omp parallel for
-            for (int i = 0; i < pTriangleList->size(); ++i)
-            {
-                DrawTriangle(pTriangleList->at(i));
-            }
+            DrawTriangleList(*pTriangleList);
         }
+        return;
+    }
 
-        if (auto pLineList = mLineList.lock())
+    auto pMaterial = mMaterial.lock();
+    if (pMaterial)
+    {
+        pMaterial->ResolveSamplers(mRasteriserSettings.sampleFilter);
+    }
+
+    if (auto pGBuffer = mGBuffer.lock())
+    {
+        mDrawID = pGBuffer->RegisterDraw(mMaterial, mPixelShader);
+    }
+
+    if (auto pVisibilityBuffer = mVisibilityBuffer.lock())
+    {
+        auto pTriangleList = mTriangleList.lock();
+        mDrawID = pTriangleList ? pVisibilityBuffer->RegisterDraw(pTriangleList->size(), mMaterial, mPixelShader) : RePiVisibilityBuffer::EmptyDraw;
+    }
+
+    if (auto pTriangleList = mTriangleList.lock())
+    {
+        DrawTriangleList(*pTriangleList);
+
+        // The shading pass refetches from these, the geometry stage refills the list it gets back
+        if (auto pVisibilityBuffer = mVisibilityBuffer.lock())
         {
-#pragma omp parallel for
-            for (int i = 0; i < pLineList->size(); ++i)
-            {
-                DrawLine(pLineList->at(i));
-            }
+            pVisibilityBuffer->AdoptTriangles(mDrawID, *pTriangleList);
         }
+    }
 
-        if (auto pPointList = mPointList.lock())
+    // Debug lines and points are few and overlap freely, they stay on this thread
+    const RePiInt2 AllRows(0, int32_t(mSize.y) - 1);
+    if (auto pLineList = mLineList.lock())
+    {
+        for (auto& Line : *pLineList)
         {
-#pragma omp parallel for
-            for (int i = 0; i < pPointList->size(); ++i)
-            {
-                DrawPoint(pPointList->at(i));
-            }
+            DrawLine(Line, AllRows);
+        }
+    }
+
+    if (auto pPointList = mPointList.lock())
+    {
+        for (auto& Point : *pPointList)
+        {
+            DrawPoint(Point);
         }
     }
+
+    if (pMaterial)
+    {
+        pMaterial->ReleaseSamplers();
+    }
 }
 
-RePiFloat2 RePiRasterizerStage::ClipToUV(
-    const RePiFloat4& Clip) const
+RePiFloat2 RePiRasterizerStage::NdcToScreen(
+    const RePiFloat2& Ndc,
+    const RePiFloat2& Size)
+{
+    return RePiFloat2(0.5f * (Ndc.x + 1.f), 0.5f * (1.f - Ndc.y)) * RePiFloat2(Size.x - 1.f, Size.y - 1.f);
+}
+
+RePiFloat2 RePiRasterizerStage::ScreenToNdc(
+    const RePiFloat2& xy,
+    const RePiFloat2& Size)
 {
-    return RePiFloat2(0.5f * (Clip.x + 1.f), 0.5f * (1.f - Clip.y));
+    return RePiFloat2(
+        2.f * xy.x / RePiMath::max(Size.x - 1.f, 1.f) - 1.f,
+        1.f - 2.f * xy.y / RePiMath::max(Size.y - 1.f, 1.f));
 }
 
 RePiInt2 RePiRasterizerStage::ClipToXY(
     const RePiFloat4& Clip) const
 {
-    RePiFloat2 Result = ClipToUV(Clip) * RePiFloat2(mSize.x - 1.f, mSize.y - 1.f);
+    RePiFloat2 Result = NdcToScreen(RePiFloat2(Clip.x, Clip.y), mSize);
 
     return RePiInt2(int32_t(Result.x), int32_t(Result.y));
 }
@@ -253,6 +345,140 @@ void RePiRasterizerStage::DrawDepth(
     }*/
 }
 
+bool RePiRasterizerStage::DepthTest(
+    const float Depth,
+    const float StoredDepth) const
+{
+    switch (mRasteriserSettings.depthFunc)
+    {
+    case RePiComparisonFunction::eNEVER:
+        return false;
+    case RePiComparisonFunction::eLESS:
+        return Depth < StoredDepth;
+    case RePiComparisonFunction::eEQUAL:
+        return Depth == StoredDepth;
+    case RePiComparisonFunction::eLESS_EQUAL:
+        return Depth <= StoredDepth;
+    case RePiComparisonFunction::eGREATER:
+        return Depth > StoredDepth;
+    case RePiComparisonFunction::eNOT_EQUAL:
+        return Depth != StoredDepth;
+    case RePiComparisonFunction::eGREATER_EQUAL:
+        return Depth >= StoredDepth;
+    case RePiComparisonFunction::eALWAYS:
+    default:
+        return true;
+    }
+}
+
+RePiRasterizerStage::RePiFragmentTargets RePiRasterizerStage::LockFragmentTargets() const
+{
+    RePiFragmentTargets Targets;
+    Targets.Target = mTarget.lock();
+    Targets.Depth = mDepth.lock();
+    Targets.Temporal = mTemporal.lock();
+    Targets.Checkerboard = mCheckerboard.lock();
+    Targets.ShadingRate = mShadingRate.lock();
+    Targets.GBuffer = mGBuffer.lock();
+    Targets.VisibilityBuffer = mVisibilityBuffer.lock();
+
+    return Targets;
+}
+
+void RePiRasterizerStage::DrawFragment(
+    const RePiFragmentTargets& Targets,
+    const RePiInt2& xy,
+    RePiVertex& V,
+    const uint32_t TriangleID) const
+{
+    const float z = V.Position.z;
+
+    // Depth covers every pixel even when shading is skipped, the resolves rely on it
+    if (nullptr != Targets.Depth && mRasteriserSettings.depthEnable)
+    {
+        if (!DepthTest(z, Targets.Depth->LoadData(xy)))
+        {
+            return;
+        }
+
+        if (mRasteriserSettings.depthWrite)
+        {
+            Targets.Depth->WriteData(xy, z);
+        }
+    }
+
+    if (nullptr != Targets.VisibilityBuffer)
+    {
+        if (xy.x < Targets.VisibilityBuffer->GetSize().x && xy.y < Targets.VisibilityBuffer->GetSize().y)
+        {
+            Targets.VisibilityBuffer->Write(xy, z, mDrawID, TriangleID);
+        }
+        return;
+    }
+
+    // Only fragments that pass the depth test pay for unpacking the normal
+    V.Normal = V.GetFrameNormal();
+
+    if (nullptr != Targets.GBuffer)
+    {
+        if (xy.x < Targets.GBuffer->GetSize().x && xy.y < Targets.GBuffer->GetSize().y)
+        {
+            Targets.GBuffer->Write(xy, z, V.TexCoord, V.Normal, mDrawID);
+        }
+        return;
+    }
+
+    if (nullptr != Targets.Checkerboard && !Targets.Checkerboard->IsShaded(xy))
+    {
+        return;
+    }
+
+    RePiLinearColor Color = RePiLinearColor::Black;
+    if (nullptr == Targets.Temporal || !Targets.Temporal->Reproject(xy, z, Color))
+    {
+        const RePiShadingRate Rate = nullptr == Targets.ShadingRate ? RePiShadingRate::eRATE_1X1 : Targets.ShadingRate->GetRate(xy);
+        Color = RePiShadingRate::eRATE_1X1 == Rate ? mPixelShader(V, mMaterial, mConstantBuffer) : ShadeCoarse(xy, V, Rate);
+    }
+
+    Targets.Target->WriteColor(xy, Color);
+}
+
+RePiLinearColor RePiRasterizerStage::ShadeCoarse(
+    const RePiInt2& xy,
+    const RePiVertex& V,
+    const RePiShadingRate Rate) const
+{
+    const RePiInt2 Block = RePiShadingRateImage::GetRateSize(Rate);
+    const RePiInt2 Anchor(xy.x & ~(Block.x - 1), xy.y & ~(Block.y - 1));
+
+    auto& Cache = g_CoarseShadingCache;
+    if (Cache.Entries.size() < static_cast<size_t>(mSize.x))
+    {
+        Cache.Entries.resize(static_cast<size_t>(mSize.x));
+    }
+
+    auto& Entry = Cache.Entries[Anchor.x];
+    if (Entry.Stamp == Cache.Stamp && Entry.AnchorY == Anchor.y)
+    {
+        return Entry.Color;
+    }
+
+    // Attributes move to the coarse pixel's center, the footprint grows with it
+    const float OffsetX = Anchor.x + 0.5f * (Block.x - 1) - xy.x;
+    const float OffsetY = Anchor.y + 0.5f * (Block.y - 1) - xy.y;
+
+    RePiVertex Coarse = V;
+    Coarse.TexCoord = V.TexCoord + V.TexCoordDdx * OffsetX + V.TexCoordDdy * OffsetY;
+    Coarse.TexCoordDdx = V.TexCoordDdx * float(Block.x);
+    Coarse.TexCoordDdy = V.TexCoordDdy * float(Block.y);
+
+    Entry.Stamp = Cache.Stamp;
+    Entry.AnchorY = Anchor.y;
+    Entry.Color = mPixelShader(Coarse, mMaterial, mConstantBuffer);
+
+    return Entry.Color;
+}
+
 void RePiRasterizerStage::DrawPixel(const RePiInt2& xy, const RePiLinearColor& Color) const
 {
     /*RePiFloat2 uv = clipToUV(clip);
@@ -306,7 +532,8 @@ void RePiRasterizerStage::DrawPoint(
 }
 
 void RePiRasterizerStage::DrawLine(
-    const RePiLine& L) const
+    const RePiLine& L,
+    const RePiInt2& Rows) const
 {
     RePiInt2 p0 = ClipToXY(L.v0.Position);
     RePiInt2 p1 = ClipToXY(L.v1.Position);
@@ -340,7 +567,7 @@ void RePiRasterizerStage::DrawLine(
         {
             if (auto pBuffer = mConstantBuffer.lock())
             {
-                if (mPixelShader)
+                if (mPixelShader && y >= Rows.x && y <= Rows.y)
                 {
                     pTarget->WriteColor(RePiInt2(x, y), RePiLinearColor(RePiColor(0, 255, 0 ,255)));
                 }
@@ -361,8 +588,58 @@ void RePiRasterizerStage::DrawLine(
     }
 }
 
+void RePiRasterizerStage::DrawTriangleList(
+    const std::vector<RePiTriangle>& TriangleList)
+{
+    const int32_t BandCount = (int32_t(mSize.y) + BandHeight - 1) / BandHeight;
+    if (BandCount <= 0)
+    {
+        return;
+    }
+
+    if (mBands.size() < static_cast<size_t>(BandCount))
+    {
+        mBands.resize(BandCount);
+    }
+    for (auto& Band : mBands)
+    {
+        Band.clear();
+    }
+
+    // Bands keep submission order, every pixel sees its triangles in the same order a serial loop would
+    for (uint32_t i = 0; i < TriangleList.size(); ++i)
+    {
+        const RePiTriangle& T = TriangleList[i];
+        const int32_t y0 = ClipToXY(T.v0.Position).y;
+        const int32_t y1 = ClipToXY(T.v1.Position).y;
+        const int32_t y2 = ClipToXY(T.v2.Position).y;
+
+        const int32_t MinY = RePiMath::max(RePiMath::min(y0, RePiMath::min(y1, y2)), 0);
+        const int32_t MaxY = RePiMath::min(RePiMath::max(y0, RePiMath::max(y1, y2)), int32_t(mSize.y) - 1);
+
+        for (int32_t Band = MinY / BandHeight; Band <= MaxY / BandHeight && MinY <= MaxY; ++Band)
+        {
+            mBands[Band].push_back(i);
+        }
+    }
+
+    // A band's rows belong to one thread, so depth test, depth write and color write never race
+#pragma omp parallel for schedule(dynamic)
+    for (int32_t Band = 0; Band < BandCount; ++Band)
+    {
+        const RePiInt2 Rows(Band * BandHeight, RePiMath::min((Band + 1) * BandHeight, int32_t(mSize.y)) - 1);
+
+        for (const uint32_t i : mBands[Band])
+        {
+            DrawTriangle(TriangleList[i], Rows, i);
+        }
+    }
+}
+
 void RePiRasterizerStage::DrawTriangle(
-    const RePiTriangle& T) const
+    const RePiTriangle& T,
+    const RePiInt2& Rows,
+    const uint32_t TriangleID) const
 {
     bool draw = false;
 
@@ -380,21 +657,32 @@ void RePiRasterizerStage::DrawTriangle(
         return;
     }
 
+    if (!mPixelShader)
+    {
+        DrawDepthTriangle(T, Rows);
+        return;
+    }
+
     if (mRasteriserSettings.wireframe)
     {
         RePiLine Line1 = RePiLine(T.v0, T.v1);
-        DrawLine(Line1);
+        DrawLine(Line1, Rows);
 
         RePiLine Line2 = RePiLine(T.v1, T.v2);
-        DrawLine(Line2);
+        DrawLine(Line2, Rows);
 
         RePiLine Line3 = RePiLine(T.v2, T.v0);
-        DrawLine(Line3);
+        DrawLine(Line3, Rows);
     }
     else
     {
         RePiVertex v1 = T.v0, v2 = T.v1, v3 = T.v2;
-        
+
+        // Before sorting, while v1 is still the provoking vertex
+        v1.TangentHandedness = RePiVertex::AlignTangentFrames(v1.TangentFrame, v2.TangentFrame, v3.TangentFrame);
+        v2.TangentHandedness = v1.TangentHandedness;
+        v3.TangentHandedness = v1.TangentHandedness;
+
         RePiInt2 P = ClipToXY(v1.Position);
         v1.Position = RePiFloat4(float(P.x), float(P.y), v1.Position.z, v1.Position.w);
 
@@ -410,11 +698,11 @@ void RePiRasterizerStage::DrawTriangle(
 
         if (v2.Position.y == v3.Position.y)
         {
-            DrawBottomTri({ v1, v2, v3 });
+            DrawBottomTri({ v1, v2, v3 }, Rows, TriangleID);
         }
         else if (v1.Position.y == v2.Position.y)
         {
-            DrawTopTri({ v1, v2, v3 });
+            DrawTopTri({ v1, v2, v3 }, Rows, TriangleID);
         }
         else
         {
@@ -428,16 +716,94 @@ void RePiRasterizerStage::DrawTriangle(
             float new_v = v1.TexCoord.y + ((v2.Position.y - v1.Position.y) *
                 (v3.TexCoord.y - v1.TexCoord.y) / (v3.Position.y - v1.Position.y));
 
-            RePiVertex new_vtx = { { float(new_x), v2.Position.y, 0.f }, { new_u, new_v } };
+            float new_z = v1.Position.z + ((v2.Position.y - v1.Position.y) *
+                (v3.Position.z - v1.Position.z) / (v3.Position.y - v1.Position.y));
+
+            RePiFloat4 new_q = v1.TangentFrame + (v3.TangentFrame - v1.TangentFrame) * ((v2.Position.y - v1.Position.y) / (v3.Position.y - v1.Position.y));
+
+            RePiVertex new_vtx = { { float(new_x), v2.Position.y, new_z }, { new_u, new_v } };
+            new_vtx.TangentFrame = new_q;
+            new_vtx.TangentHandedness = v1.TangentHandedness;
+
+            DrawBottomTri({ v1, new_vtx, v2 }, Rows, TriangleID);
+            DrawTopTri({ v2, new_vtx, v3 }, Rows, TriangleID);
+        }
+    }
+}
+
+void RePiRasterizerStage::DrawDepthTriangle(
+    const RePiTriangle& T,
+    const RePiInt2& Rows) const
+{
+    // Depth is the only output here, nothing to do when it can't be written
+    auto pDepth = mDepth.lock();
+    if (nullptr == pDepth || !mRasteriserSettings.depthWrite)
+    {
+        return;
+    }
+
+    // Same snapping as the filled path
+    RePiFloat3 P[3];
+    const RePiFloat4* Clip[3] = { &T.v0.Position, &T.v1.Position, &T.v2.Position };
+    for (int32_t i = 0; i < 3; ++i)
+    {
+        const RePiInt2 xy = ClipToXY(*Clip[i]);
+        P[i] = RePiFloat3(float(xy.x), float(xy.y), Clip[i]->z);
+    }
+
+    if (P[0].y > P[1].y) std::swap(P[0], P[1]);
+    if (P[0].y > P[2].y) std::swap(P[0], P[2]);
+    if (P[1].y > P[2].y) std::swap(P[1], P[2]);
+
+    if (P[0].y == P[2].y)
+    {
+        return;
+    }
+
+    const int32_t MinY = RePiMath::max(int32_t(P[0].y), Rows.x);
+    const int32_t MaxY = RePiMath::min(int32_t(P[2].y), Rows.y);
 
-            DrawBottomTri({ v1, new_vtx, v2 });
-            DrawTopTri({ v2, new_vtx, v3 });
+    for (int32_t y = MinY; y <= MaxY; ++y)
+    {
+        // Long edge 0-2 on one side, 0-1 or 1-2 on the other
+        const float t = (y - P[0].y) / (P[2].y - P[0].y);
+        float xa = P[0].x + (P[2].x - P[0].x) * t;
+        float za = P[0].z + (P[2].z - P[0].z) * t;
+
+        const bool Upper = y < P[1].y || P[1].y == P[2].y;
+        const RePiFloat3& E0 = Upper ? P[0] : P[1];
+        const RePiFloat3& E1 = Upper ? P[1] : P[2];
+        const float s = E1.y == E0.y ? 1.f : (y - E0.y) / (E1.y - E0.y);
+        float xb = E0.x + (E1.x - E0.x) * s;
+        float zb = E0.z + (E1.z - E0.z) * s;
+
+        if (xa > xb)
+        {
+            std::swap(xa, xb);
+            std::swap(za, zb);
+        }
+
+        const float dz = xb > xa ? (zb - za) / (xb - xa) : 0.f;
+        const int32_t MinX = RePiMath::max(int32_t(xa), 0);
+        const int32_t MaxX = RePiMath::min(int32_t(xb), int32_t(mSize.x) - 1);
+
+        for (int32_t x = MinX; x <= MaxX; ++x)
+        {
+            const RePiInt2 xy(x, y);
+            const float z = za + (x - xa) * dz;
+
+            if (!mRasteriserSettings.depthEnable || DepthTest(z, pDepth->LoadData(xy)))
+            {
+                pDepth->WriteData(xy, z);
+            }
         }
     }
 }
 
 void RePiRasterizerStage::DrawBottomTri(
-    const RePiTriangle& T) const
+    const RePiTriangle& T,
+    const RePiInt2& Rows,
+    const uint32_t TriangleID) const
 {
     RePiVertex v1 = T.v0, v2 = T.v1, v3 = T.v2;
     if (v3.Position.x < v2.Position.x) std::swap(v2, v3);
@@ -453,34 +819,59 @@ void RePiRasterizerStage::DrawBottomTri(
     float du_right = (v3.TexCoord.x - v1.TexCoord.x) / height;
     float dv_right = (v3.TexCoord.y - v1.TexCoord.y) / height;
 
+    float dz_left = (v2.Position.z - v1.Position.z) / height;
+    float dz_right = (v3.Position.z - v1.Position.z) / height;
+
+    RePiFloat4 dq_left = (v2.TangentFrame - v1.TangentFrame) * (1.f / height);
+    RePiFloat4 dq_right = (v3.TangentFrame - v1.TangentFrame) * (1.f / height);
+
     float xs = v1.Position.x, xe = v1.Position.x;
     float us = v1.TexCoord.x, vs = v1.TexCoord.y;
     float ue = v1.TexCoord.x, ve = v1.TexCoord.y;
+    float zs = v1.Position.z, ze = v1.Position.z;
+    RePiFloat4 qs = v1.TangentFrame, qe = v1.TangentFrame;
 
-    if (mTarget.expired())
+    const RePiFragmentTargets Targets = LockFragmentTargets();
+    if (nullptr == Targets.Target)
     {
         return;
     }
-    auto pTarget = mTarget.lock();
+    ++g_CoarseShadingCache.Stamp;
 
-    for (int y = int(v1.Position.y); y <= int(v3.Position.y); ++y)
+    const int LastRow = RePiMath::min(int(v3.Position.y), Rows.y);
+    for (int y = int(v1.Position.y); y <= LastRow; ++y)
     {
         int left = static_cast<int>(xs);
         int right = static_cast<int>(xe);
         if (left > right) std::swap(left, right);
 
-        float u = us, v = vs;
+        float u = us, v = vs, z = zs;
         float du = (ue - us) / (right - left + 1);
         float dv = (ve - vs) / (right - left + 1);
+        float dz = (ze - zs) / (right - left + 1);
+        RePiFloat4 q = qs;
+        RePiFloat4 dq = (qe - qs) * (1.f / (right - left + 1));
 
-        for (int x = RePiMath::max(0, left); x <= RePiMath::min(int(mSize.x) - 1, right); ++x)
-        {
-            RePiVertex V(RePiFloat4::ZERO, RePiFloat2(u, v));
-            RePiLinearColor pixelColor = mPixelShader(V, mMaterial, mConstantBuffer);
-            pTarget->WriteColor(RePiInt2(x, y), pixelColor);
+        // Texcoords are affine across the triangle, so the derivatives are constant along the span
+        RePiFloat2 Ddx(du, dv);
+        RePiFloat2 Ddy(du_left - dx_left * du, dv_left - dx_left * dv);
 
-            u += du;
-            v += dv;
+        if (y >= Rows.x)
+        {
+            for (int x = RePiMath::max(0, left); x <= RePiMath::min(int(mSize.x) - 1, right); ++x)
+            {
+                RePiVertex V(RePiFloat3(float(x), float(y), z), RePiFloat2(u, v));
+                V.TangentFrame = q;
+                V.TangentHandedness = v1.TangentHandedness;
+                V.TexCoordDdx = Ddx;
+                V.TexCoordDdy = Ddy;
+                DrawFragment(Targets, RePiInt2(x, y), V, TriangleID);
+
+                u += du;
+                v += dv;
+                z += dz;
+                q = q + dq;
+            }
         }
 
         xs += dx_left;
@@ -489,11 +880,17 @@ void RePiRasterizerStage::DrawBottomTri(
         vs += dv_left;
         ue += du_right;
         ve += dv_right;
+        zs += dz_left;
+        ze += dz_right;
+        qs = qs + dq_left;
+        qe = qe + dq_right;
     }
 }
 
 void RePiRasterizerStage::DrawTopTri(
-    const RePiTriangle& T) const
+    const RePiTriangle& T,
+    const RePiInt2& Rows,
+    const uint32_t TriangleID) const
 {
     RePiVertex v1 = T.v0, v2 = T.v1, v3 = T.v2;
     if (v2.Position.x < v1.Position.x) std::swap(v1, v2);
@@ -509,34 +906,59 @@ void RePiRasterizerStage::DrawTopTri(
     float du_right = (v3.TexCoord.x - v2.TexCoord.x) / height;
     float dv_right = (v3.TexCoord.y - v2.TexCoord.y) / height;
 
+    float dz_left = (v3.Position.z - v1.Position.z) / height;
+    float dz_right = (v3.Position.z - v2.Position.z) / height;
+
+    RePiFloat4 dq_left = (v3.TangentFrame - v1.TangentFrame) * (1.f / height);
+    RePiFloat4 dq_right = (v3.TangentFrame - v2.TangentFrame) * (1.f / height);
+
     float xs = v1.Position.x, xe = v2.Position.x;
     float us = v1.TexCoord.x, vs = v1.TexCoord.y;
     float ue = v2.TexCoord.x, ve = v2.TexCoord.y;
+    float zs = v1.Position.z, ze = v2.Position.z;
+    RePiFloat4 qs = v1.TangentFrame, qe = v2.TangentFrame;
 
-    if (mTarget.expired())
+    const RePiFragmentTargets Targets = LockFragmentTargets();
+    if (nullptr == Targets.Target)
     {
         return;
     }
-    auto pTarget = mTarget.lock();
+    ++g_CoarseShadingCache.Stamp;
 
-    for (int y = int(v1.Position.y); y <= int(v3.Position.y); ++y)
+    const int LastRow = RePiMath::min(int(v3.Position.y), Rows.y);
+    for (int y = int(v1.Position.y); y <= LastRow; ++y)
     {
         int left = static_cast<int>(xs);
         int right = static_cast<int>(xe);
         if (left > right) std::swap(left, right);
 
-        float u = us, v = vs;
+        float u = us, v = vs, z = zs;
         float du = (ue - us) / (right - left + 1);
         float dv = (ve - vs) / (right - left + 1);
+        float dz = (ze - zs) / (right - left + 1);
+        RePiFloat4 q = qs;
+        RePiFloat4 dq = (qe - qs) * (1.f / (right - left + 1));
 
-        for (int x = RePiMath::max(0, left); x <= RePiMath::min(int(mSize.x) - 1, right); ++x)
-        {
-            RePiVertex V(RePiFloat4::ZERO, RePiFloat2(u, v));
-            RePiLinearColor pixelColor = mPixelShader(V, mMaterial, mConstantBuffer);
-            pTarget->WriteColor(RePiInt2(x, y), pixelColor);
+        // Texcoords are affine across the triangle, so the derivatives are constant along the span
+        RePiFloat2 Ddx(du, dv);
+        RePiFloat2 Ddy(du_left - dx_left * du, dv_left - dx_left * dv);
 
-            u += du;
-            v += dv;
+        if (y >= Rows.x)
+        {
+            for (int x = RePiMath::max(0, left); x <= RePiMath::min(int(mSize.x) - 1, right); ++x)
+            {
+                RePiVertex V(RePiFloat3(float(x), float(y), z), RePiFloat2(u, v));
+                V.TangentFrame = q;
+                V.TangentHandedness = v1.TangentHandedness;
+                V.TexCoordDdx = Ddx;
+                V.TexCoordDdy = Ddy;
+                DrawFragment(Targets, RePiInt2(x, y), V, TriangleID);
+
+                u += du;
+                v += dv;
+                z += dz;
+                q = q + dq;
+            }
         }
 
         xs += dx_left;
@@ -545,6 +967,10 @@ void RePiRasterizerStage::DrawTopTri(
         vs += dv_left;
         ue += du_right;
         ve += dv_right;
+        zs += dz_left;
+        ze += dz_right;
+        qs = qs + dq_left;
+        qe = qe + dq_right;
     }
 }
 
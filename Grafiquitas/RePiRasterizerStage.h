@@ -7,6 +7,13 @@ struct RePiLine;
 struct RePiTriangle;
 class RePiMaterial;
 class RePiTexture;
+class RePiTemporalReprojection;
+class RePiCheckerboard;
+class RePiShadingRateImage;
+class RePiGBuffer;
+class RePiVisibilityBuffer;
+class RePiLightGrid;
+class RePiCascadedShadowMap;
 
 struct RasteriserSettings
 {
@@ -39,8 +46,38 @@ struct RasteriserSettings
     bool wireframe;
 };
 
+struct RePiPointLight
+{
+    RePiPointLight(
+        const RePiFloat3& _position = RePiFloat3::ZERO,
+        const float _radius = 100.f,
+        const RePiLinearColor& _color = RePiLinearColor::White,
+        const float _intensity = 1.f)
+        : position(_position)
+        , radius(_radius)
+        , color(_color)
+        , intensity(_intensity)
+    {
+    };
+
+    ~RePiPointLight() = default;
+
+    // World space, the light has no effect past the radius
+    RePiFloat3 position;
+    float radius;
+    RePiLinearColor color;
+    float intensity;
+};
+
 struct RasterizerConstantBuffer
 {
+    std::vector<RePiPointLight> LightList;
+
+    // Rebuilt from LightList every frame, lit shaders only walk the lights of their cluster
+    std::shared_ptr<RePiLightGrid> LightGrid;
+
+    // Set while shadows are on, lit shaders darken what the light's depth passes didn't reach
+    std::shared_ptr<RePiCascadedShadowMap> ShadowMap;
 };
 
 using PixelShader = std::function<RePiLinearColor(const RePiVertex&, const std::weak_ptr<RePiMaterial>&, const std::weak_ptr<RasterizerConstantBuffer>&)>;
@@ -78,12 +115,42 @@ public:
     void BindPixelShader(
         const PixelShader& PixelShader);
 
+    // Optional, covered pixels the history can serve skip the pixel shader
+    void BindTemporal(
+        const std::weak_ptr<RePiTemporalReprojection>& Temporal = std::weak_ptr<RePiTemporalReprojection>());
+
+    // Optional, only half the pixels are shaded and the rest is left for the checkerboard resolve
+    void BindCheckerboard(
+        const std::weak_ptr<RePiCheckerboard>& Checkerboard = std::weak_ptr<RePiCheckerboard>());
+
+    // Optional, tiles below full rate shade once per coarse pixel, depth stays per pixel
+    void BindShadingRate(
+        const std::weak_ptr<RePiShadingRateImage>& ShadingRate = std::weak_ptr<RePiShadingRateImage>());
+
+    // Deferred mode, visible fragments go to the G-buffer and shading waits for RePiGBuffer::Shade
+    void BindGBuffer(
+        const std::weak_ptr<RePiGBuffer>& GBuffer = std::weak_ptr<RePiGBuffer>());
+
+    // Visibility mode, visible fragments only record their draw and triangle, RePiVisibilityBuffer::Shade does the rest
+    // The bound triangle list is swapped into the buffer after each draw and comes back empty
+    void BindVisibilityBuffer(
+        const std::weak_ptr<RePiVisibilityBuffer>& VisibilityBuffer = std::weak_ptr<RePiVisibilityBuffer>());
+
+    // Without a pixel shader bound, triangles only write depth, no color and no varyings
+    // Triangles are binned into row bands and each band is drawn by a single thread, in submission order
     void Execute();
 
-private:
-    RePiFloat2 ClipToUV(
-        const RePiFloat4& Clip = RePiFloat4::ZERO) const;
+    // NDC to unsnapped pixel coordinates, y flips and the NDC edges land on the edge pixel centers
+    static RePiFloat2 NdcToScreen(
+        const RePiFloat2& Ndc = RePiFloat2::ZERO,
+        const RePiFloat2& Size = RePiFloat2::ZERO);
 
+    // Inverse of NdcToScreen
+    static RePiFloat2 ScreenToNdc(
+        const RePiFloat2& xy = RePiFloat2::ZERO,
+        const RePiFloat2& Size = RePiFloat2::ZERO);
+
+private:
     RePiInt2 ClipToXY(
         const RePiFloat4& Clip = RePiFloat4::ZERO) const;
 
@@ -102,6 +169,38 @@ private:
         const RePiInt2& xy = RePiInt2::ZERO,
         const float Depth = 0.f) const;
 
+    bool DepthTest(
+        const float Depth = 0.f,
+        const float StoredDepth = 0.f) const;
+
+    // Everything a triangle half reads or writes per fragment, locked once per half
+    struct RePiFragmentTargets
+    {
+        std::shared_ptr<RePiTexture> Target;
+        std::shared_ptr<RePiTexture> Depth;
+        std::shared_ptr<RePiTemporalReprojection> Temporal;
+        std::shared_ptr<RePiCheckerboard> Checkerboard;
+        std::shared_ptr<RePiShadingRateImage> ShadingRate;
+        std::shared_ptr<RePiGBuffer> GBuffer;
+        std::shared_ptr<RePiVisibilityBuffer> VisibilityBuffer;
+    };
+
+    RePiFragmentTargets LockFragmentTargets() const;
+
+    // Depth tests one covered pixel and shades it, or reuses the history when the temporal cache can
+    // V's normal is unpacked from its tangent frame once the pixel is known to be visible
+    void DrawFragment(
+        const RePiFragmentTargets& Targets,
+        const RePiInt2& xy,
+        RePiVertex& V,
+        const uint32_t TriangleID = 0) const;
+
+    // Shades the coarse pixel holding xy once per triangle and hands the result to the rest of it
+    RePiLinearColor ShadeCoarse(
+        const RePiInt2& xy,
+        const RePiVertex& V,
+        const RePiShadingRate Rate) const;
+
     void DrawPixel(
         const RePiInt2& xy = RePiInt2::ZERO,
         const RePiLinearColor& Color = RePiLinearColor::Black) const;
@@ -109,17 +208,34 @@ private:
     void DrawPoint(
         const RePiVertex& P) const;
 
+    // Rows.x and Rows.y are the first and last rows the call may write
     void DrawLine(
-        const RePiLine& L) const;
+        const RePiLine& L,
+        const RePiInt2& Rows) const;
+
+    // Bins the list by row band, then draws the bands in parallel
+    void DrawTriangleList(
+        const std::vector<RePiTriangle>& TriangleList);
 
     void DrawTriangle(
-        const RePiTriangle& T) const;
+        const RePiTriangle& T,
+        const RePiInt2& Rows,
+        const uint32_t TriangleID = 0) const;
+
+    // Depth-only scan conversion, walks nothing but x and z
+    void DrawDepthTriangle(
+        const RePiTriangle& T,
+        const RePiInt2& Rows) const;
 
     void DrawBottomTri(
-        const RePiTriangle& T) const;
+        const RePiTriangle& T,
+        const RePiInt2& Rows,
+        const uint32_t TriangleID = 0) const;
 
     void DrawTopTri(
-        const RePiTriangle& T) const;
+        const RePiTriangle& T,
+        const RePiInt2& Rows,
+        const uint32_t TriangleID = 0) const;
 
 private:
     std::weak_ptr<std::vector<RePiTriangle>> mTriangleList;
@@ -130,9 +246,19 @@ private:
     std::weak_ptr<RePiTexture> mTarget;
     std::weak_ptr<RePiTexture> mDepth;
     std::weak_ptr<RasterizerConstantBuffer> mConstantBuffer;
+    std::weak_ptr<RePiTemporalReprojection> mTemporal;
+    std::weak_ptr<RePiCheckerboard> mCheckerboard;
+    std::weak_ptr<RePiShadingRateImage> mShadingRate;
+    std::weak_ptr<RePiGBuffer> mGBuffer;
+    std::weak_ptr<RePiVisibilityBuffer> mVisibilityBuffer;
+    uint32_t mDrawID = 0;
     PixelShader mPixelShader;
     RePiFloat2 mSize;
 
+    // Triangle indices per row band, kept between draws so binning doesn't allocate
+    std::vector<std::vector<uint32_t>> mBands;
+    static const int32_t BandHeight = 16;
+
     enum REGION_CODE
     {
         INSIDE = 0,
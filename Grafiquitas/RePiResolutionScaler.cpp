@@ -0,0 +1,202 @@
+#include "RePiResolutionScaler.h"
+
+#include "RePiTexture.h"
+
+RePiResolutionScaler::RePiResolutionScaler(
+    const float FrameBudget,
+    const float MinScale,
+    const float MaxScale) :
+    mFrameBudget(0.f),
+    mMinScale(1.f),
+    mMaxScale(1.f),
+    mScale(1.f),
+    mSharpness(0.5f),
+    mAverageFrameTime(0.f),
+    mFramesSinceChange(0),
+    mTapSizes{ RePiInt2::ZERO, RePiInt2::ZERO }
+{
+    // Starts at the clamped maximum
+    SetFrameBudget(FrameBudget);
+    SetScaleRange(MinScale, MaxScale);
+}
+
+void RePiResolutionScaler::SetFrameBudget(
+    const float FrameBudget)
+{
+    mFrameBudget = RePiMath::max(FrameBudget, 0.001f);
+}
+
+void RePiResolutionScaler::SetScaleRange(
+    const float MinScale,
+    const float MaxScale)
+{
+    mMinScale = RePiMath::clamp(MinScale, ScaleStep, 1.f);
+    mMaxScale = RePiMath::clamp(MaxScale, mMinScale, 1.f);
+    mScale = RePiMath::clamp(mScale, mMinScale, mMaxScale);
+}
+
+void RePiResolutionScaler::SetSharpness(
+    const float Sharpness)
+{
+    mSharpness = RePiMath::clamp(Sharpness, 0.f, 1.f);
+}
+
+bool RePiResolutionScaler::Update(
+    const float FrameTime)
+{
+    // Hitches such as loading stalls would drag the average for seconds
+    if (FrameTime <= 0.f || FrameTime > MaxFrameTime)
+    {
+        return false;
+    }
+
+    // Smooths out single slow frames
+    mAverageFrameTime = mAverageFrameTime > 0.f ? RePiMath::lerp(mAverageFrameTime, FrameTime, 0.1f) : FrameTime;
+
+    if (++mFramesSinceChange < SettleFrames)
+    {
+        return false;
+    }
+
+    // Raster cost follows the pixel count, so the scale goes with the square root of the time ratio
+    float Target = mScale * std::sqrt(mFrameBudget / mAverageFrameTime);
+    Target = RePiMath::clamp(std::floor(Target / ScaleStep) * ScaleStep, mMinScale, mMaxScale);
+
+    // Only grow when there is a full step of headroom, otherwise it would bounce around the budget
+    const bool Shrink = Target < mScale;
+    const bool Grow = Target >= mScale + ScaleStep;
+    if (!Shrink && !Grow)
+    {
+        return false;
+    }
+
+    mScale = Shrink ? Target : mScale + ScaleStep;
+    mFramesSinceChange = 0;
+
+    return true;
+}
+
+RePiInt2 RePiResolutionScaler::GetInternalSize(
+    const RePiInt2& OutputSize) const
+{
+    return RePiInt2(
+        RePiMath::max(static_cast<int32_t>(OutputSize.x * mScale), 1),
+        RePiMath::max(static_cast<int32_t>(OutputSize.y * mScale), 1));
+}
+
+void RePiResolutionScaler::BuildTaps(
+    std::vector<RePiUpscaleTap>& Taps,
+    const int32_t SourceSize,
+    const int32_t TargetSize,
+    const int32_t Stride)
+{
+    Taps.resize(TargetSize);
+
+    const float Ratio = float(SourceSize) / float(TargetSize);
+    for (int32_t i = 0; i < TargetSize; ++i)
+    {
+        // Pixel centers line up at half integers on both sides
+        const float Coord = RePiMath::max((i + 0.5f) * Ratio - 0.5f, 0.f);
+        const int32_t i0 = RePiMath::min(static_cast<int32_t>(Coord), SourceSize - 1);
+        const int32_t i1 = RePiMath::min(i0 + 1, SourceSize - 1);
+
+        Taps[i].Offset0 = i0 * Stride;
+        Taps[i].Offset1 = i1 * Stride;
+        Taps[i].Weight = Coord - float(i0);
+    }
+}
+
+void RePiResolutionScaler::Upscale(
+    RePiTexture& Source,
+    RePiTexture& Target)
+{
+    const RePiFloat2 SourceSize = Source.GetSize();
+    const RePiFloat2 TargetSize = Target.GetSize();
+
+    const uint8_t* Src = static_cast<const uint8_t*>(Source.GetBufferData());
+    uint8_t* Dst = static_cast<uint8_t*>(Target.GetBufferData());
+    if (nullptr == Src || nullptr == Dst)
+    {
+        return;
+    }
+
+    const int32_t SourceWidth = int32_t(SourceSize.x);
+    const int32_t SourceHeight = int32_t(SourceSize.y);
+    const int32_t TargetWidth = int32_t(TargetSize.x);
+    const int32_t TargetHeight = int32_t(TargetSize.y);
+
+    if (SourceWidth == TargetWidth && SourceHeight == TargetHeight)
+    {
+        memcpy(Dst, Src, static_cast<size_t>(TargetWidth) * TargetHeight * 4);
+        return;
+    }
+
+    // Rebuilt only when a size changes
+    const RePiInt2 Sizes[2] = { RePiInt2(SourceWidth, SourceHeight), RePiInt2(TargetWidth, TargetHeight) };
+    if (Sizes[0] != mTapSizes[0] || Sizes[1] != mTapSizes[1])
+    {
+        BuildTaps(mColumnTaps, SourceWidth, TargetWidth, 4);
+        BuildTaps(mRowTaps, SourceHeight, TargetHeight, SourceWidth * 4);
+        mTapSizes[0] = Sizes[0];
+        mTapSizes[1] = Sizes[1];
+    }
+
+    const float Sharpness = mSharpness;
+
+#pragma omp parallel for
+    for (int32_t y = 0; y < TargetHeight; ++y)
+    {
+        const RePiUpscaleTap& Row = mRowTaps[y];
+        const uint8_t* Row0 = Src + Row.Offset0;
+        const uint8_t* Row1 = Src + Row.Offset1;
+        uint8_t* Out = Dst + static_cast<size_t>(y) * TargetWidth * 4;
+
+        for (int32_t x = 0; x < TargetWidth; ++x, Out += 4)
+        {
+            const RePiUpscaleTap& Column = mColumnTaps[x];
+
+#if defined(REPI_SIMD_SSE41)
+            const __m128 p00 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(*reinterpret_cast<const int32_t*>(Row0 + Column.Offset0))));
+            const __m128 p10 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(*reinterpret_cast<const int32_t*>(Row0 + Column.Offset1))));
+            const __m128 p01 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(*reinterpret_cast<const int32_t*>(Row1 + Column.Offset0))));
+            const __m128 p11 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(*reinterpret_cast<const int32_t*>(Row1 + Column.Offset1))));
+
+            const __m128 fx = _mm_set1_ps(Column.Weight);
+            const __m128 fy = _mm_set1_ps(Row.Weight);
+            const __m128 Top = _mm_add_ps(p00, _mm_mul_ps(_mm_sub_ps(p10, p00), fx));
+            const __m128 Bottom = _mm_add_ps(p01, _mm_mul_ps(_mm_sub_ps(p11, p01), fx));
+            const __m128 Bilinear = _mm_add_ps(Top, _mm_mul_ps(_mm_sub_ps(Bottom, Top), fy));
+
+            // Pushes the blend away from the footprint's mean, clamped so edges don't ring
+            const __m128 Mean = _mm_mul_ps(_mm_add_ps(_mm_add_ps(p00, p10), _mm_add_ps(p01, p11)), _mm_set1_ps(0.25f));
+            const __m128 Lo = _mm_min_ps(_mm_min_ps(p00, p10), _mm_min_ps(p01, p11));
+            const __m128 Hi = _mm_max_ps(_mm_max_ps(p00, p10), _mm_max_ps(p01, p11));
+            __m128 Result = _mm_add_ps(Bilinear, _mm_mul_ps(_mm_sub_ps(Bilinear, Mean), _mm_set1_ps(Sharpness)));
+            Result = _mm_min_ps(_mm_max_ps(Result, Lo), Hi);
+
+            const __m128i Packed = _mm_cvtps_epi32(Result);
+            *reinterpret_cast<int32_t*>(Out) = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packus_epi32(Packed, Packed), _mm_setzero_si128()));
+#else
+            for (int32_t c = 0; c < 4; ++c)
+            {
+                const float p00 = Row0[Column.Offset0 + c];
+                const float p10 = Row0[Column.Offset1 + c];
+                const float p01 = Row1[Column.Offset0 + c];
+                const float p11 = Row1[Column.Offset1 + c];
+
+                const float Top = p00 + (p10 - p00) * Column.Weight;
+                const float Bottom = p01 + (p11 - p01) * Column.Weight;
+                const float Bilinear = Top + (Bottom - Top) * Row.Weight;
+
+                // Pushes the blend away from the footprint's mean, clamped so edges don't ring
+                const float Mean = (p00 + p10 + p01 + p11) * 0.25f;
+                const float Lo = RePiMath::min(RePiMath::min(p00, p10), RePiMath::min(p01, p11));
+                const float Hi = RePiMath::max(RePiMath::max(p00, p10), RePiMath::max(p01, p11));
+                const float Result = RePiMath::clamp(Bilinear + (Bilinear - Mean) * Sharpness, Lo, Hi);
+
+                Out[c] = static_cast<uint8_t>(Result + 0.5f);
+            }
+#endif
+        }
+    }
+}
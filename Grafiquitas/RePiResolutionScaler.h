@@ -0,0 +1,94 @@
+#pragma once
+
+#include "RePiBase.h"
+
+class RePiTexture;
+
+class RePiResolutionScaler
+{
+public:
+    RePiResolutionScaler(
+        const float FrameBudget = 1.f / 30.f,
+        const float MinScale = 0.5f,
+        const float MaxScale = 1.f);
+
+    ~RePiResolutionScaler() = default;
+
+    // Target frame time in seconds
+    void SetFrameBudget(
+        const float FrameBudget = 1.f / 30.f);
+
+    float GetFrameBudget() const
+    {
+        return mFrameBudget;
+    }
+
+    void SetScaleRange(
+        const float MinScale = 0.5f,
+        const float MaxScale = 1.f);
+
+    // 0 is plain bilinear, 1 restores most of the contrast bilinear blends away
+    void SetSharpness(
+        const float Sharpness = 0.5f);
+
+    // Feeds the measured frame time, returns true when the internal resolution changes
+    bool Update(
+        const float FrameTime = 0.f);
+
+    float GetScale() const
+    {
+        return mScale;
+    }
+
+    RePiInt2 GetInternalSize(
+        const RePiInt2& OutputSize = RePiInt2::ZERO) const;
+
+    // Sharpened bilinear upscale of an 8 bit RGBA target, the bytes are filtered as stored
+    void Upscale(
+        RePiTexture& Source,
+        RePiTexture& Target);
+
+private:
+    struct RePiUpscaleTap
+    {
+        int32_t Offset0 = 0;
+        int32_t Offset1 = 0;
+        float Weight = 0.f;
+    };
+
+    static void BuildTaps(
+        std::vector<RePiUpscaleTap>& Taps,
+        const int32_t SourceSize = 0,
+        const int32_t TargetSize = 0,
+        const int32_t Stride = 0);
+
+private:
+    // Scale moves in steps so the pool only ever sees a handful of sizes
+    static constexpr float ScaleStep = 1.f / 16.f;
+
+    static constexpr float MaxFrameTime = 1.f;
+
+    // Frames to wait after a change so the average reflects the new size
+    static const uint32_t SettleFrames = 8;
+
+    float mFrameBudget;
+
+    float mMinScale;
+
+    float mMaxScale;
+
+    float mScale;
+
+    float mSharpness;
+
+    float mAverageFrameTime;
+
+    uint32_t mFramesSinceChange;
+
+    std::vector<RePiUpscaleTap> mColumnTaps;
+
+    std::vector<RePiUpscaleTap> mRowTaps;
+
+    // Source and target sizes the taps were built for
+    RePiInt2 mTapSizes[2];
+};
@@ -8,8 +8,12 @@
 #include "RePiTexture.h"
 #include "RePiMaterial.h"
 
+#include <filesystem>
+
 RePiResourceManager::RePiResourceManager() :
-    mIsReady(false)
+    mIsReady(false),
+    mCompressTextures(false),
+    mBakeTextures(false)
 {
 }
 
@@ -18,6 +22,18 @@ RePiResourceManager::~RePiResourceManager()
     CleanupResources();
 }
 
+void RePiResourceManager::SetTextureCompression(
+    const bool Enable)
+{
+    mCompressTextures = Enable;
+}
+
+void RePiResourceManager::SetTextureBaking(
+    const bool Enable)
+{
+    mBakeTextures = Enable;
+}
+
 std::weak_ptr<RePiAnimator> RePiResourceManager::CreateAnimator(
     const std::string& FilePath)
 {
@@ -237,6 +253,36 @@ const std::string RePiResourceManager::GetFullFileName(
     return FilePath.substr(LastSlashIndex + 1, FilePath.size());
 }
 
+const std::string RePiResourceManager::GetTexturePath(
+    const std::string& RootPath,
+    const std::string& RawPath) const
+{
+    const auto FileName = RootPath + GetFileName(RawPath);
+
+    // Prefer a baked copy, which maps as is, then the referenced file, then block compressed data
+    std::vector<std::string> Candidates;
+    Candidates.push_back(FileName + ".rptx");
+    auto LastPointIndex = RawPath.find_last_of(".");
+    if (LastPointIndex != std::string::npos && LastPointIndex > RawPath.find_last_of("/\\") + 1)
+    {
+        Candidates.push_back(FileName + RawPath.substr(LastPointIndex));
+    }
+    Candidates.push_back(FileName + ".dds");
+    Candidates.push_back(FileName + ".tga");
+    Candidates.push_back(FileName + ".bmp");
+
+    for (auto& Candidate : Candidates)
+    {
+        std::error_code Error;
+        if (std::filesystem::exists(Candidate, Error))
+        {
+            return Candidate;
+        }
+    }
+
+    return Candidates.back();
+}
+
 const std::weak_ptr<RePiSkeleton> RePiResourceManager::GetSkeleton(
     const uint32_t Key,
     const std::string& FilePath,
@@ -266,6 +312,8 @@ const std::weak_ptr<RePiSkeleton> RePiResourceManager::GetSkeleton(
 
         ProcessRawBone(Skeleton, std::weak_ptr<RePiBone>(), RawData->mRootNode, RawData);
 
+        Skeleton->BuildHierarchy();
+
         mSkeletonMap[Key] = Skeleton;
     }
 
@@ -416,6 +464,26 @@ const std::weak_ptr<RePiTexture> RePiResourceManager::GetImage(
             return std::weak_ptr<RePiTexture>();
         }
 
+        // Baked before the color space, mips and compression are applied, those are redone on every load
+        const auto ExtensionIndex = FilePath.find_last_of(".");
+        if (mBakeTextures && ExtensionIndex != std::string::npos && FilePath.substr(ExtensionIndex) != ".rptx")
+        {
+            Image->SaveBaked(FilePath.substr(0, ExtensionIndex) + ".rptx");
+        }
+
+        bool IsColor = TextureUsage == RePiTextureUsages::eDiffuse || TextureUsage == RePiTextureUsages::eSpecular;
+        if (IsColor)
+        {
+            Image->SetSRGB(true);
+            Image->GenerateMips();
+        }
+
+        // Normal maps and shadow maps lose too much precision in BC1/BC3
+        if (mCompressTextures && IsColor && !Image->Compress())
+        {
+            RePiLog(RePiLogLevel::eWARNING, "Unable to compress texture: " + FilePath);
+        }
+
         mImageMap[Key] = Image;
     }
 
@@ -446,10 +514,12 @@ const std::weak_ptr<RePiMaterial> RePiResourceManager::GetMaterial(
         std::string RootPath = GetFolderPath(FilePath);
         aiString Path;
 
+        std::string DiffuseRawPath;
         std::weak_ptr<RePiTexture> Image = mDifuseError;
         if (AI_SUCCESS == RawMaterialData->GetTexture(aiTextureType_DIFFUSE, 0, &Path))
         {
-            auto TexturePath = RootPath + GetFileName(std::string(Path.C_Str())) + ".bmp";
+            DiffuseRawPath = Path.C_Str();
+            auto TexturePath = GetTexturePath(RootPath, DiffuseRawPath);
 
             auto Diffuse = GetImage(GetHashFromString(TexturePath), TexturePath, RePiTextureUsages::eDiffuse);
             if (!Diffuse.expired())
@@ -457,7 +527,39 @@ const std::weak_ptr<RePiMaterial> RePiResourceManager::GetMaterial(
                 Image = Diffuse;
             }
         }
-        Material->AddImageResource(Image);
+        Material->SetImageResource(RePiTextureUsages::eDiffuse, Image, RePiSamplerState(RePiSampleFilter::eFILTER_ANISOTROPIC, RePiTextureAdressMode::eCLAMP, 8));
+
+        // Doom 3 materials only name the diffuse, their normal map sits next to it as <name>_local
+        std::string NormalsPath;
+        if (AI_SUCCESS == RawMaterialData->GetTexture(aiTextureType_NORMALS, 0, &Path))
+        {
+            NormalsPath = GetTexturePath(RootPath, std::string(Path.C_Str()));
+        }
+        else if (!DiffuseRawPath.empty())
+        {
+            auto LastPointIndex = DiffuseRawPath.find_last_of(".");
+            if (LastPointIndex != std::string::npos && LastPointIndex > DiffuseRawPath.find_last_of("/\\") + 1)
+            {
+                DiffuseRawPath = DiffuseRawPath.substr(0, LastPointIndex);
+            }
+
+            std::error_code Error;
+            NormalsPath = GetTexturePath(RootPath, DiffuseRawPath + "_local");
+            if (!std::filesystem::exists(NormalsPath, Error))
+            {
+                NormalsPath.clear();
+            }
+        }
+
+        if (!NormalsPath.empty())
+        {
+            // No mips on normal maps, so anisotropy has nothing to pick from
+            auto Normals = GetImage(GetHashFromString(NormalsPath), NormalsPath, RePiTextureUsages::eNormals);
+            if (!Normals.expired())
+            {
+                Material->SetImageResource(RePiTextureUsages::eNormals, Normals, RePiSamplerState(RePiSampleFilter::eFILTER_LINEAR, RePiTextureAdressMode::eCLAMP, 1));
+            }
+        }
 
         mMaterialMap[Key] = Material;
     }
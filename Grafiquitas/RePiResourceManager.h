@@ -42,6 +42,14 @@ public:
         const std::string& FilePath = "",
         const std::weak_ptr<RePiAnimator>& Animator = std::weak_ptr<RePiAnimator>());
 
+    // Color textures loaded after this call are kept block compressed in memory
+    void SetTextureCompression(
+        const bool Enable = true);
+
+    // Textures decoded from BMP, TGA or DDS get a .rptx copy next to them, which later runs map without decoding
+    void SetTextureBaking(
+        const bool Enable = true);
+
 private:
     void CleanupResources();
 
@@ -57,6 +65,10 @@ private:
     const std::string GetFullFileName(
         const std::string& FilePath = "") const;
 
+    const std::string GetTexturePath(
+        const std::string& RootPath = "",
+        const std::string& RawPath = "") const;
+
     const std::weak_ptr<RePiSkeleton> GetSkeleton(
         const uint32_t Key,
         const std::string& FilePath = "",
@@ -129,6 +141,10 @@ private:
 
     bool mIsReady;
 
+    bool mCompressTextures;
+
+    bool mBakeTextures;
+
     std::weak_ptr<RePiTexture> mDifuseError;
 
     std::hash<std::string> Hasher;
@@ -0,0 +1,24 @@
+#include "RePiSampler.h"
+
+void RePiSampler::Bind(
+    const std::weak_ptr<RePiTexture>& Texture,
+    const RePiSamplerState& State,
+    const RePiSampleFilter MaxFilter)
+{
+    Unbind();
+
+    if (auto pTexture = Texture.lock())
+    {
+        const RePiSampleFilter Filter = State.filter < MaxFilter ? State.filter : MaxFilter;
+
+        mTexture = pTexture;
+        mSampleFunction = RePiTexture::ResolveSampleFunction(State.addressMode, Filter, pTexture->IsSRGB());
+        mMaxAnisotropy = State.maxAnisotropy;
+    }
+}
+
+void RePiSampler::Unbind()
+{
+    mTexture.reset();
+    mSampleFunction = nullptr;
+}
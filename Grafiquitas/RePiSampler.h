@@ -0,0 +1,62 @@
+#pragma once
+
+#include "RePiBase.h"
+#include "RePiTexture.h"
+
+struct RePiSamplerState
+{
+    RePiSamplerState(
+        const RePiSampleFilter _filter = RePiSampleFilter::eFILTER_LINEAR,
+        const RePiTextureAdressMode _addressMode = RePiTextureAdressMode::eWRAP,
+        const uint32_t _maxAnisotropy = 16)
+        : filter(_filter)
+        , addressMode(_addressMode)
+        , maxAnisotropy(_maxAnisotropy)
+    {
+    };
+
+    ~RePiSamplerState() = default;
+
+    RePiSampleFilter filter;
+    RePiTextureAdressMode addressMode;
+    uint32_t maxAnisotropy;
+};
+
+class RePiSampler
+{
+public:
+    RePiSampler() = default;
+    ~RePiSampler() = default;
+
+    // Resolves the sampling function for the draw, MaxFilter caps the state's filter
+    void Bind(
+        const std::weak_ptr<RePiTexture>& Texture = std::weak_ptr<RePiTexture>(),
+        const RePiSamplerState& State = RePiSamplerState(),
+        const RePiSampleFilter MaxFilter = RePiSampleFilter::eFILTER_ANISOTROPIC);
+
+    void Unbind();
+
+    bool IsBound() const
+    {
+        return nullptr != mSampleFunction;
+    }
+
+    RePiLinearColor Sample(
+        const RePiFloat2& uv = RePiFloat2::ZERO,
+        const RePiFloat2& Ddx = RePiFloat2::ZERO,
+        const RePiFloat2& Ddy = RePiFloat2::ZERO) const
+    {
+        if (nullptr == mSampleFunction)
+        {
+            return RePiLinearColor::Black;
+        }
+
+        return mSampleFunction(*mTexture, uv, Ddx, Ddy, mMaxAnisotropy);
+    }
+
+private:
+    // Kept alive while bound so the pixel shader skips the weak_ptr lock
+    std::shared_ptr<RePiTexture> mTexture;
+    RePiSampleFunction mSampleFunction = nullptr;
+    uint32_t mMaxAnisotropy = 16;
+};
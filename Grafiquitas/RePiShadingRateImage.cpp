@@ -0,0 +1,120 @@
+#include "RePiShadingRateImage.h"
+
+#include "RePiTexture.h"
+
+RePiShadingRateImage::RePiShadingRateImage() :
+    mSize(RePiInt2::ZERO),
+    mTiles(RePiInt2::ZERO)
+{
+}
+
+void RePiShadingRateImage::Resize(
+    const RePiInt2& Size)
+{
+    mSize = Size;
+    mTiles = RePiInt2((Size.x + TileSize - 1) >> TileShift, (Size.y + TileSize - 1) >> TileShift);
+    mRates.assign(static_cast<size_t>(mTiles.x) * mTiles.y, RePiShadingRate::eRATE_1X1);
+}
+
+void RePiShadingRateImage::SetTileRate(
+    const RePiInt2& Tile,
+    const RePiShadingRate Rate)
+{
+    if (Tile.x < 0 || Tile.x >= mTiles.x || Tile.y < 0 || Tile.y >= mTiles.y)
+    {
+        return;
+    }
+
+    mRates[Tile.y * mTiles.x + Tile.x] = static_cast<uint8_t>(Rate);
+}
+
+void RePiShadingRateImage::Generate(
+    const RePiTexture& Color)
+{
+    const RePiFloat2 ColorSize = Color.GetSize();
+    const RePiInt2 Size(int32_t(ColorSize.x), int32_t(ColorSize.y));
+    if (Size != mSize)
+    {
+        Resize(Size);
+    }
+
+    mLuminance.resize(static_cast<size_t>(mSize.x) * mSize.y);
+
+#pragma omp parallel for
+    for (int32_t y = 0; y < mSize.y; ++y)
+    {
+        for (int32_t x = 0; x < mSize.x; ++x)
+        {
+            const RePiLinearColor Texel = Color.LoadColor(RePiInt2(x, y));
+
+            // Square root is close enough to the eye's response to compare steps
+            mLuminance[static_cast<size_t>(y) * mSize.x + x] = std::sqrt(0.2126f * Texel.r + 0.7152f * Texel.g + 0.0722f * Texel.b);
+        }
+    }
+
+#pragma omp parallel for
+    for (int32_t ty = 0; ty < mTiles.y; ++ty)
+    {
+        for (int32_t tx = 0; tx < mTiles.x; ++tx)
+        {
+            const int32_t x0 = tx << TileShift;
+            const int32_t y0 = ty << TileShift;
+            const int32_t x1 = RePiMath::min(x0 + TileSize, mSize.x);
+            const int32_t y1 = RePiMath::min(y0 + TileSize, mSize.y);
+
+            float GradientX = 0.f;
+            float GradientY = 0.f;
+            for (int32_t y = y0; y < y1; ++y)
+            {
+                const float* Row = &mLuminance[static_cast<size_t>(y) * mSize.x];
+                for (int32_t x = x0; x < x1; ++x)
+                {
+                    if (x + 1 < mSize.x)
+                    {
+                        GradientX = RePiMath::max(GradientX, std::abs(Row[x + 1] - Row[x]));
+                    }
+                    if (y + 1 < mSize.y)
+                    {
+                        GradientY = RePiMath::max(GradientY, std::abs(Row[x + mSize.x] - Row[x]));
+                    }
+                }
+            }
+
+            const float Gradient = RePiMath::max(GradientX, GradientY);
+
+            RePiShadingRate Rate = RePiShadingRate::eRATE_1X1;
+            if (Gradient < Threshold4x4)
+            {
+                Rate = RePiShadingRate::eRATE_4X4;
+            }
+            else if (Gradient < Threshold2x2)
+            {
+                Rate = RePiShadingRate::eRATE_2X2;
+            }
+            else if (GradientY < Threshold2x2)
+            {
+                // Detail runs across the rows only, so pairs of rows can share shading
+                Rate = RePiShadingRate::eRATE_1X2;
+            }
+
+            mRates[ty * mTiles.x + tx] = static_cast<uint8_t>(Rate);
+        }
+    }
+}
+
+RePiInt2 RePiShadingRateImage::GetRateSize(
+    const RePiShadingRate Rate)
+{
+    switch (Rate)
+    {
+    case RePiShadingRate::eRATE_1X2:
+        return RePiInt2(1, 2);
+    case RePiShadingRate::eRATE_2X2:
+        return RePiInt2(2, 2);
+    case RePiShadingRate::eRATE_4X4:
+        return RePiInt2(4, 4);
+    case RePiShadingRate::eRATE_1X1:
+    default:
+        return RePiInt2(1, 1);
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "RePiBase.h"
+
+class RePiTexture;
+
+class RePiShadingRateImage
+{
+public:
+    RePiShadingRateImage();
+
+    ~RePiShadingRateImage() = default;
+
+    // Every tile starts at full rate
+    void Resize(
+        const RePiInt2& Size = RePiInt2::ZERO);
+
+    void SetTileRate(
+        const RePiInt2& Tile = RePiInt2::ZERO,
+        const RePiShadingRate Rate = RePiShadingRate::eRATE_1X1);
+
+    RePiShadingRate GetRate(
+        const RePiInt2& xy = RePiInt2::ZERO) const
+    {
+        if (xy.x < 0 || xy.x >= mSize.x || xy.y < 0 || xy.y >= mSize.y)
+        {
+            return RePiShadingRate::eRATE_1X1;
+        }
+
+        return static_cast<RePiShadingRate>(mRates[(xy.y >> TileShift) * mTiles.x + (xy.x >> TileShift)]);
+    }
+
+    // Picks each tile's rate from the luminance gradient of a finished frame, flat tiles go coarse
+    void Generate(
+        const RePiTexture& Color);
+
+    static RePiInt2 GetRateSize(
+        const RePiShadingRate Rate = RePiShadingRate::eRATE_1X1);
+
+    static const int32_t TileShift = 3;
+    static const int32_t TileSize = 1 << TileShift;
+
+private:
+    // Largest perceptual luminance step inside a tile that each rate tolerates
+    static constexpr float Threshold4x4 = 0.02f;
+    static constexpr float Threshold2x2 = 0.06f;
+
+    RePiInt2 mSize;
+
+    RePiInt2 mTiles;
+
+    std::vector<uint8_t> mRates;
+
+    // Scratch luminance of the frame being analysed
+    std::vector<float> mLuminance;
+};
@@ -0,0 +1,155 @@
+#include "RePiShadowMap.h"
+
+#include "RePi3DModel.h"
+#include "RePiRasterizerStage.h"
+#include "RePiTexture.h"
+
+RePiShadowMap::RePiShadowMap(
+    const int32_t Resolution,
+    const float DepthBias) :
+    mDepth(std::make_shared<RePiTexture>()),
+    mResolution(RePiMath::max(Resolution, 2)),
+    mDepthBias(DepthBias),
+    mDirection(0.f, -1.f, 0.f),
+    mRadius(1.f),
+    mDepthRange(2.f),
+    mView(RePiMatrix::IDENTITY),
+    mProjection(RePiMatrix::IDENTITY),
+    mScreenToShadow(RePiMatrix::IDENTITY),
+    mScreenSize(RePiInt2::ZERO)
+{
+    mDepth->Create(RePiInt2(mResolution, mResolution), RePiTextureFormat::eR32_FLOAT);
+    mDepth->ClearData(1.f);
+}
+
+void RePiShadowMap::SetLight(
+    const RePiFloat3& Direction,
+    const RePiFloat3& Center,
+    const float Radius,
+    const float CasterExtent)
+{
+    mDirection = Direction.sizeSquared() > 0.f ? Direction.getSafeNormal() : RePiFloat3(0.f, -1.f, 0.f);
+
+    const RePiFloat3 Up = GetLightUp(mDirection);
+    const float Extent = RePiMath::max(CasterExtent, 0.f);
+    const RePiFloat3 Eye = Center - mDirection * (Radius + Extent);
+
+    // The box spans [0, 2 * Radius + Extent] in front of the eye, which maps to depth [0, 1]
+    mRadius = Radius;
+    mDepthRange = 2.f * Radius + Extent;
+    mView = RePiLookAtMatrix(Eye, Center, Up);
+    mProjection = RePiOrthoMatrix(Radius, Radius, 1.f / mDepthRange, 0.f);
+}
+
+RePiFloat3 RePiShadowMap::GetLightUp(
+    const RePiFloat3& Direction)
+{
+    return std::abs(RePiFloat3::dot(Direction, RePiFloat3::UP)) > 0.99f ? RePiFloat3(0.f, 0.f, 1.f) : RePiFloat3::UP;
+}
+
+void RePiShadowMap::Clear()
+{
+    mDepth->ClearData(1.f);
+}
+
+void RePiShadowMap::BindScreen(
+    const RePiMatrix& ViewProjection,
+    const RePiInt2& Size)
+{
+    mScreenSize = Size;
+    mScreenToShadow = ViewProjection.inverseFast() * (mView * mProjection);
+}
+
+float RePiShadowMap::ComputeShadow(
+    const RePiVertex& V) const
+{
+    if (mScreenSize.x < 2 || mScreenSize.y < 2)
+    {
+        return 1.f;
+    }
+
+    return SampleShadow(GetShadowClip(V));
+}
+
+RePiFloat4 RePiShadowMap::GetShadowClip(
+    const RePiVertex& V) const
+{
+    const RePiFloat2 xy = RePiRasterizerStage::ScreenToNdc(RePiFloat2(V.Position.x, V.Position.y), RePiFloat2(float(mScreenSize.x), float(mScreenSize.y)));
+    const RePiFloat4 Ndc(xy.x, xy.y, V.Position.z, 1.f);
+
+    return mScreenToShadow.transformVector4(Ndc);
+}
+
+bool RePiShadowMap::Covers(
+    const RePiFloat4& ShadowClip) const
+{
+    if (ShadowClip.w <= 0.f)
+    {
+        return false;
+    }
+
+    // Two texels of border keep the 4x4 footprint off the clamped edge
+    const float Limit = 1.f - 4.f / mResolution;
+    const float x = ShadowClip.x / ShadowClip.w;
+    const float y = ShadowClip.y / ShadowClip.w;
+    const float z = ShadowClip.z / ShadowClip.w;
+
+    return std::abs(x) <= Limit && std::abs(y) <= Limit && z >= 0.f && z <= 1.f;
+}
+
+bool RePiShadowMap::Intersects(
+    const RePiFloat3& Center,
+    const float Radius) const
+{
+    const RePiFloat4 Light = mView.transformVector4(RePiFloat4(Center, 1.f));
+
+    return std::abs(Light.x) <= mRadius + Radius &&
+           std::abs(Light.y) <= mRadius + Radius &&
+           Light.z >= -Radius &&
+           Light.z <= mDepthRange + Radius;
+}
+
+float RePiShadowMap::SampleShadow(
+    const RePiFloat4& ShadowClip) const
+{
+    if (ShadowClip.w <= 0.f)
+    {
+        return 1.f;
+    }
+
+    const float x = ShadowClip.x / ShadowClip.w;
+    const float y = ShadowClip.y / ShadowClip.w;
+    const float Depth = ShadowClip.z / ShadowClip.w - mDepthBias;
+
+    // Outside the light's box nothing was rendered, so nothing can occlude
+    if (x < -1.f || x > 1.f || y < -1.f || y > 1.f || Depth >= 1.f)
+    {
+        return 1.f;
+    }
+
+    const RePiFloat2 p = RePiRasterizerStage::NdcToScreen(RePiFloat2(x, y), RePiFloat2(float(mResolution), float(mResolution)));
+    const int32_t bx = int32_t(p.x);
+    const int32_t by = int32_t(p.y);
+    const float fx = p.x - bx;
+    const float fy = p.y - by;
+
+    // Three bilinear comparisons per axis collapse to four texels weighted (1 - f, 1, 1, f) / 3
+    const float WeightsX[4] = { (1.f - fx) / 3.f, 1.f / 3.f, 1.f / 3.f, fx / 3.f };
+    const float WeightsY[4] = { (1.f - fy) / 3.f, 1.f / 3.f, 1.f / 3.f, fy / 3.f };
+
+    float Lit = 0.f;
+    for (int32_t j = 0; j < 4; ++j)
+    {
+        const int32_t ty = RePiMath::clamp(by - 1 + j, 0, mResolution - 1);
+        for (int32_t i = 0; i < 4; ++i)
+        {
+            const int32_t tx = RePiMath::clamp(bx - 1 + i, 0, mResolution - 1);
+            if (Depth <= mDepth->LoadData(RePiInt2(tx, ty)))
+            {
+                Lit += WeightsX[i] * WeightsY[j];
+            }
+        }
+    }
+
+    return Lit;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "RePiBase.h"
+
+struct RePiVertex;
+class RePiTexture;
+
+// Orthographic depth map of a directional light, filled by a depth-only rasterizer pass
+class RePiShadowMap
+{
+public:
+    RePiShadowMap(
+        const int32_t Resolution = 1024,
+        const float DepthBias = 0.002f);
+
+    ~RePiShadowMap() = default;
+
+    // Fits the light's box around the sphere that has to receive shadows, casters up to CasterExtent further toward the light still land in it
+    void SetLight(
+        const RePiFloat3& Direction,
+        const RePiFloat3& Center,
+        const float Radius,
+        const float CasterExtent = 0.f);
+
+    void SetDepthBias(
+        const float DepthBias = 0.002f)
+    {
+        mDepthBias = DepthBias;
+    }
+
+    // Empties the map before the depth-only pass
+    void Clear();
+
+    // Takes the camera the lookups come from, pixels then go straight to shadow space
+    void BindScreen(
+        const RePiMatrix& ViewProjection,
+        const RePiInt2& Size);
+
+    // 1 lit, 0 shadowed, 3x3 tent filtered over the map's texels
+    float ComputeShadow(
+        const RePiVertex& V) const;
+
+    float SampleShadow(
+        const RePiFloat4& ShadowClip) const;
+
+    RePiFloat4 GetShadowClip(
+        const RePiVertex& V) const;
+
+    // Whether the filter footprint at this position stays inside the map
+    bool Covers(
+        const RePiFloat4& ShadowClip) const;
+
+    // Whether a world space sphere reaches the light's box
+    bool Intersects(
+        const RePiFloat3& Center,
+        const float Radius) const;
+
+    std::shared_ptr<RePiTexture> GetDepth() const
+    {
+        return mDepth;
+    }
+
+    RePiMatrix GetView() const
+    {
+        return mView;
+    }
+
+    RePiMatrix GetProjection() const
+    {
+        return mProjection;
+    }
+
+    // Direction the light travels, world space
+    RePiFloat3 GetDirection() const
+    {
+        return mDirection;
+    }
+
+    int32_t GetResolution() const
+    {
+        return mResolution;
+    }
+
+    // Up vector the light's view is built with, anything not parallel to the light
+    static RePiFloat3 GetLightUp(
+        const RePiFloat3& Direction);
+
+private:
+    std::shared_ptr<RePiTexture> mDepth;
+
+    int32_t mResolution;
+
+    float mDepthBias;
+
+    RePiFloat3 mDirection;
+
+    // Half size of the box across, and its depth range
+    float mRadius;
+    float mDepthRange;
+
+    RePiMatrix mView;
+
+    RePiMatrix mProjection;
+
+    // Camera pixel depth to light clip space
+    RePiMatrix mScreenToShadow;
+
+    RePiInt2 mScreenSize;
+};
@@ -0,0 +1,88 @@
+#include "RePiTemporalReprojection.h"
+
+#include "RePiGeometryStage.h"
+#include "RePiRasterizerStage.h"
+
+RePiTemporalReprojection::RePiTemporalReprojection(
+    const uint32_t RefreshInterval) :
+    mViewProjection(RePiMatrix::IDENTITY),
+    mPrevViewProjection(RePiMatrix::IDENTITY),
+    mReprojection(RePiMatrix::IDENTITY),
+    mSize(RePiInt2::ZERO),
+    mRefreshInterval(RePiMath::max(RefreshInterval, 1u)),
+    mFrame(0)
+{
+}
+
+void RePiTemporalReprojection::SetRefreshInterval(
+    const uint32_t RefreshInterval)
+{
+    mRefreshInterval = RePiMath::max(RefreshInterval, 1u);
+}
+
+void RePiTemporalReprojection::BeginFrame(
+    const GeometryConstantBuffer& Buffer,
+    const RePiInt2& Size)
+{
+    if (Size != mSize)
+    {
+        mSize = Size;
+        mHistory.Invalidate();
+    }
+
+    mPrevViewProjection = mViewProjection;
+    mViewProjection = Buffer.View * Buffer.Projection;
+    mReprojection = mViewProjection.inverseFast() * mPrevViewProjection;
+
+    ++mFrame;
+}
+
+bool RePiTemporalReprojection::Reproject(
+    const RePiInt2& xy,
+    const float Depth,
+    RePiLinearColor& Color) const
+{
+    if (!mHistory.IsValid() || mSize.x < 2 || mSize.y < 2)
+    {
+        return false;
+    }
+
+    // Rotating diagonal pattern, a checkerboard when the interval is 2
+    if (0 == (xy.x + (mRefreshInterval - 1) * xy.y + mFrame) % mRefreshInterval)
+    {
+        return false;
+    }
+
+    const RePiFloat2 Size(float(mSize.x), float(mSize.y));
+    const RePiFloat2 Ndc = RePiRasterizerStage::ScreenToNdc(RePiFloat2(float(xy.x), float(xy.y)), Size);
+
+    const RePiFloat4 Clip = mReprojection.transformVector4(RePiFloat4(Ndc.x, Ndc.y, Depth, 1.f));
+    if (Clip.w <= 0.f)
+    {
+        return false;
+    }
+
+    const float PrevDepth = Clip.z / Clip.w;
+    const RePiFloat2 PrevScreen = RePiRasterizerStage::NdcToScreen(RePiFloat2(Clip.x / Clip.w, Clip.y / Clip.w), Size);
+    const RePiInt2 PrevXY(
+        static_cast<int32_t>(std::floor(PrevScreen.x + 0.5f)),
+        static_cast<int32_t>(std::floor(PrevScreen.y + 0.5f)));
+
+    if (PrevXY.x < 0 || PrevXY.x >= mSize.x || PrevXY.y < 0 || PrevXY.y >= mSize.y)
+    {
+        return false;
+    }
+
+    return mHistory.Load(PrevXY, PrevDepth, Color);
+}
+
+void RePiTemporalReprojection::EndFrame(
+    const RePiTexture& Color,
+    const RePiTexture& Depth)
+{
+    mHistory.Store(Color, Depth);
+    if (Color.GetSize() != RePiFloat2(float(mSize.x), float(mSize.y)))
+    {
+        mHistory.Invalidate();
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "RePiBase.h"
+#include "RePiFrameHistory.h"
+#include "RePiTexture.h"
+
+struct GeometryConstantBuffer;
+
+class RePiTemporalReprojection
+{
+public:
+    RePiTemporalReprojection(
+        const uint32_t RefreshInterval = 4);
+
+    ~RePiTemporalReprojection() = default;
+
+    // Every pixel is shaded at least once per interval, 1 shades every pixel every frame
+    void SetRefreshInterval(
+        const uint32_t RefreshInterval = 4);
+
+    uint32_t GetRefreshInterval() const
+    {
+        return mRefreshInterval;
+    }
+
+    // Takes this frame's camera, history of another size is dropped
+    void BeginFrame(
+        const GeometryConstantBuffer& Buffer,
+        const RePiInt2& Size = RePiInt2::ZERO);
+
+    // True when the pixel can reuse last frame's shading, Color receives it
+    bool Reproject(
+        const RePiInt2& xy,
+        const float Depth,
+        RePiLinearColor& Color) const;
+
+    // Keeps this frame's targets as the next frame's history
+    void EndFrame(
+        const RePiTexture& Color,
+        const RePiTexture& Depth);
+
+    void Invalidate()
+    {
+        mHistory.Invalidate();
+    }
+
+private:
+    RePiFrameHistory mHistory;
+
+    RePiMatrix mViewProjection;
+
+    RePiMatrix mPrevViewProjection;
+
+    // Current pixel depth to previous clip space
+    RePiMatrix mReprojection;
+
+    RePiInt2 mSize;
+
+    uint32_t mRefreshInterval;
+
+    uint32_t mFrame;
+};
@@ -1,88 +1,745 @@
 #include "RePiTexture.h"
 
-void RePiTexture::Create(
-    const RePiInt2& Size,
+#include "RePiImageWriter.h"
+
+#include <array>
+#include <cmath>
+
+// Anisotropic probes never exceed this, it bounds the per-sample stack arrays
+static const uint32_t MaxAnisotropyProbes = 16;
+
+// One 256 entry row per byte of a texel, so the four bytes of a texel index their rows in one go
+struct RePiTexelDecode
+{
+    float Table[4][256];
+};
+
+static const RePiTexelDecode BuildTexelDecode(
+    const bool Normalize,
+    const bool SRGB)
+{
+    RePiTexelDecode Decode;
+
+    for (int32_t i = 0; i < 256; ++i)
+    {
+        const float Unorm = float(i) / 255.f;
+        const float Linear = Unorm <= 0.04045f ? Unorm / 12.92f : std::pow((Unorm + 0.055f) / 1.055f, 2.4f);
+        const float Color = Normalize ? (SRGB ? Linear : Unorm) : float(i);
+
+        Decode.Table[0][i] = Color;
+        Decode.Table[1][i] = Color;
+        Decode.Table[2][i] = Color;
+        Decode.Table[3][i] = Normalize ? Unorm : float(i);
+    }
+
+    return Decode;
+}
+
+// Raw keeps bytes in 0-255 for data textures, alpha is never gamma encoded
+static const RePiTexelDecode g_DecodeRaw = BuildTexelDecode(false, false);
+static const RePiTexelDecode g_DecodeUnorm = BuildTexelDecode(true, false);
+static const RePiTexelDecode g_DecodeSRGB = BuildTexelDecode(true, true);
+
+// Linear to sRGB at 12 bits of input precision, replaces the pow on every pixel write
+static const std::array<uint8_t, 4096> g_EncodeSRGB = []()
+{
+    std::array<uint8_t, 4096> Table;
+
+    for (int32_t i = 0; i < 4096; ++i)
+    {
+        const float Linear = float(i) / 4095.f;
+        const float Encoded = Linear <= 0.0031308f ? Linear * 12.92f : 1.055f * std::pow(Linear, 1.f / 2.4f) - 0.055f;
+
+        Table[i] = static_cast<uint8_t>(Encoded * 255.f + 0.5f);
+    }
+
+    return Table;
+}();
+
+static const uint8_t EncodeSRGB(
+    const float Linear)
+{
+    return g_EncodeSRGB[static_cast<uint32_t>(RePiMath::min(RePiMath::max(Linear, 0.f), 1.f) * 4095.f + 0.5f)];
+}
+
+static const uint8_t EncodeUnorm(
+    const float Value)
+{
+    return static_cast<uint8_t>(RePiMath::min(RePiMath::max(Value, 0.f), 1.f) * 255.f + 0.5f);
+}
+
+// Texel bytes in the image's byte order, three channel images read as opaque
+static void FetchTexel(
+    const RePiImage& Level,
+    const int32_t x,
+    const int32_t y,
+    uint8_t* Bytes)
+{
+    const uint32_t Bpp = Level.GetBytesPerPixel();
+
+    if (!Level.IsBlockCompressed() && Bpp >= 3)
+    {
+        const uint8_t* Texel = Level.GetPixels() + (static_cast<size_t>(y) * Level.GetWidth() + x) * Bpp;
+
+        Bytes[0] = Texel[0];
+        Bytes[1] = Texel[1];
+        Bytes[2] = Texel[2];
+        Bytes[3] = Bpp >= 4 ? Texel[3] : 255;
+
+        return;
+    }
+
+    // GetPixel hands byte 0 back as blue and byte 2 as red
+    const RePiColor Color = Level.GetPixel(RePiInt2(x, y));
+    Bytes[0] = Color.b;
+    Bytes[1] = Color.g;
+    Bytes[2] = Color.r;
+    Bytes[3] = Color.a;
+}
+
+static void AccumulateTexel(
+    const RePiImage& Level,
+    const int32_t x,
+    const int32_t y,
+    const float Weight,
+    const RePiTexelDecode& Decode,
+    float* Sum)
+{
+    uint8_t Bytes[4];
+    FetchTexel(Level, x, y, Bytes);
+
+    Sum[0] += Decode.Table[0][Bytes[0]] * Weight;
+    Sum[1] += Decode.Table[1][Bytes[1]] * Weight;
+    Sum[2] += Decode.Table[2][Bytes[2]] * Weight;
+    Sum[3] += Decode.Table[3][Bytes[3]] * Weight;
+}
+
+#if defined(REPI_SIMD_SSE41)
+// Decodes one texel held as four 32 bit lanes, one byte per lane
+static __m128 DecodeTexel4(
+    const __m128i Bytes,
+    const RePiTexelDecode& Decode)
+{
+#if defined(REPI_SIMD_AVX2)
+    return _mm_i32gather_ps(&Decode.Table[0][0], _mm_add_epi32(Bytes, _mm_setr_epi32(0, 256, 512, 768)), 4);
+#else
+    return _mm_setr_ps(Decode.Table[0][_mm_extract_epi32(Bytes, 0)],
+                       Decode.Table[1][_mm_extract_epi32(Bytes, 1)],
+                       Decode.Table[2][_mm_extract_epi32(Bytes, 2)],
+                       Decode.Table[3][_mm_extract_epi32(Bytes, 3)]);
+#endif
+}
+#endif
+
+static const int32_t GetWrapMask(
+    const int32_t Size)
+{
+    // Power of two sizes wrap with a mask, zero means the size needs a real modulo
+    return std::has_single_bit(static_cast<uint32_t>(Size)) ? Size - 1 : 0;
+}
+
+template<RePiTextureAdressMode AddressMode>
+static const int32_t AddressTexel(
+    const int32_t x,
+    const int32_t Size,
+    const int32_t WrapMask)
+{
+    if constexpr (AddressMode == RePiTextureAdressMode::eWRAP)
+    {
+        if (WrapMask != 0)
+        {
+            return x & WrapMask;
+        }
+
+        const int32_t Remainder = x % Size;
+        return Remainder + (Size & (Remainder >> 31));
+    }
+    else if constexpr (AddressMode == RePiTextureAdressMode::eMIRROR)
+    {
+        // Wrap over two periods, then fold the second one back
+        const int32_t Period = Size << 1;
+        int32_t t = 0;
+        if (WrapMask != 0)
+        {
+            t = x & (Period - 1);
+        }
+        else
+        {
+            t = x % Period;
+            t += Period & (t >> 31);
+        }
+
+        return RePiMath::min(t, Period - 1 - t);
+    }
+    else if constexpr (AddressMode == RePiTextureAdressMode::eMIRROR_ONCE)
+    {
+        // x ^ (x >> 31) maps -1, -2... onto 0, 1...
+        return RePiMath::min(x ^ (x >> 31), Size - 1);
+    }
+    else
+    {
+        return RePiMath::min(RePiMath::max(x, 0), Size - 1);
+    }
+}
+
+#if defined(REPI_SIMD_SSE41)
+template<RePiTextureAdressMode AddressMode>
+static __m128i AddressTexel4(
+    const __m128i x,
+    const int32_t Size,
+    const int32_t WrapMask)
+{
+    const __m128i Last = _mm_set1_epi32(Size - 1);
+
+    if constexpr (AddressMode == RePiTextureAdressMode::eMIRROR_ONCE)
+    {
+        return _mm_min_epi32(_mm_xor_si128(x, _mm_srai_epi32(x, 31)), Last);
+    }
+    else if constexpr (AddressMode == RePiTextureAdressMode::eWRAP || AddressMode == RePiTextureAdressMode::eMIRROR)
+    {
+        const int32_t Period = AddressMode == RePiTextureAdressMode::eWRAP ? Size : Size << 1;
+        const __m128i PeriodV = _mm_set1_epi32(Period);
+
+        __m128i t;
+        if (WrapMask != 0)
+        {
+            t = _mm_and_si128(x, _mm_set1_epi32(Period - 1));
+        }
+        else
+        {
+            // No integer divide in SSE, the float quotient is exact for any texel index we can address
+            const __m128 Quotient = _mm_floor_ps(_mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(1.f / float(Period))));
+            t = _mm_sub_epi32(x, _mm_mullo_epi32(_mm_cvtps_epi32(Quotient), PeriodV));
+            t = _mm_add_epi32(t, _mm_and_si128(PeriodV, _mm_srai_epi32(t, 31)));
+            t = _mm_sub_epi32(t, _mm_and_si128(PeriodV, _mm_cmpgt_epi32(t, _mm_sub_epi32(PeriodV, _mm_set1_epi32(1)))));
+        }
+
+        if constexpr (AddressMode == RePiTextureAdressMode::eMIRROR)
+        {
+            t = _mm_min_epi32(t, _mm_sub_epi32(_mm_sub_epi32(PeriodV, _mm_set1_epi32(1)), t));
+        }
+
+        return t;
+    }
+    else
+    {
+        return _mm_min_epi32(_mm_max_epi32(x, _mm_setzero_si128()), Last);
+    }
+}
+#endif
+
+#if defined(REPI_SIMD_AVX2)
+template<RePiTextureAdressMode AddressMode>
+static __m256i AddressTexel8(
+    const __m256i x,
+    const int32_t Size,
+    const int32_t WrapMask)
+{
+    const __m256i Last = _mm256_set1_epi32(Size - 1);
+
+    if constexpr (AddressMode == RePiTextureAdressMode::eMIRROR_ONCE)
+    {
+        return _mm256_min_epi32(_mm256_xor_si256(x, _mm256_srai_epi32(x, 31)), Last);
+    }
+    else if constexpr (AddressMode == RePiTextureAdressMode::eWRAP || AddressMode == RePiTextureAdressMode::eMIRROR)
+    {
+        const int32_t Period = AddressMode == RePiTextureAdressMode::eWRAP ? Size : Size << 1;
+        const __m256i PeriodV = _mm256_set1_epi32(Period);
+
+        __m256i t;
+        if (WrapMask != 0)
+        {
+            t = _mm256_and_si256(x, _mm256_set1_epi32(Period - 1));
+        }
+        else
+        {
+            const __m256 Quotient = _mm256_floor_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(x), _mm256_set1_ps(1.f / float(Period))));
+            t = _mm256_sub_epi32(x, _mm256_mullo_epi32(_mm256_cvtps_epi32(Quotient), PeriodV));
+            t = _mm256_add_epi32(t, _mm256_and_si256(PeriodV, _mm256_srai_epi32(t, 31)));
+            t = _mm256_sub_epi32(t, _mm256_and_si256(PeriodV, _mm256_cmpgt_epi32(t, _mm256_sub_epi32(PeriodV, _mm256_set1_epi32(1)))));
+        }
+
+        if constexpr (AddressMode == RePiTextureAdressMode::eMIRROR)
+        {
+            t = _mm256_min_epi32(t, _mm256_sub_epi32(_mm256_sub_epi32(PeriodV, _mm256_set1_epi32(1)), t));
+        }
+
+        return t;
+    }
+    else
+    {
+        return _mm256_min_epi32(_mm256_max_epi32(x, _mm256_setzero_si256()), Last);
+    }
+}
+#endif
+
+// Splits texel space coordinates into the two addressed texels a bilinear fetch blends and the blend factor
+template<RePiTextureAdressMode AddressMode>
+static void AddressTexels(
+    const float* Coords,
+    const uint32_t Count,
+    const int32_t Size,
+    int32_t* Lo,
+    int32_t* Hi,
+    float* Frac)
+{
+    const int32_t WrapMask = GetWrapMask(Size);
+    uint32_t i = 0;
+
+#if defined(REPI_SIMD_AVX2)
+    for (; i + 8 <= Count; i += 8)
+    {
+        const __m256 Coord = _mm256_loadu_ps(Coords + i);
+        const __m256 Floor = _mm256_floor_ps(Coord);
+        const __m256i x = _mm256_cvttps_epi32(Floor);
+
+        _mm256_storeu_ps(Frac + i, _mm256_sub_ps(Coord, Floor));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(Lo + i), AddressTexel8<AddressMode>(x, Size, WrapMask));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(Hi + i), AddressTexel8<AddressMode>(_mm256_add_epi32(x, _mm256_set1_epi32(1)), Size, WrapMask));
+    }
+#endif
+
+#if defined(REPI_SIMD_SSE41)
+    for (; i + 4 <= Count; i += 4)
+    {
+        const __m128 Coord = _mm_loadu_ps(Coords + i);
+        const __m128 Floor = _mm_floor_ps(Coord);
+        const __m128i x = _mm_cvttps_epi32(Floor);
+
+        _mm_storeu_ps(Frac + i, _mm_sub_ps(Coord, Floor));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(Lo + i), AddressTexel4<AddressMode>(x, Size, WrapMask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(Hi + i), AddressTexel4<AddressMode>(_mm_add_epi32(x, _mm_set1_epi32(1)), Size, WrapMask));
+    }
+#endif
+
+    for (; i < Count; ++i)
+    {
+        const float Floor = std::floor(Coords[i]);
+        const int32_t x = int32_t(Floor);
+
+        Frac[i] = Coords[i] - Floor;
+        Lo[i] = AddressTexel<AddressMode>(x, Size, WrapMask);
+        Hi[i] = AddressTexel<AddressMode>(x + 1, Size, WrapMask);
+    }
+}
+
+// Adds the bilinear blend of four addressed texels to Sum, kept in the image's byte order
+static void AccumulateBilinear(
+    const RePiImage& Level,
+    const int32_t x0,
+    const int32_t x1,
+    const int32_t y0,
+    const int32_t y1,
+    const float dx,
+    const float dy,
+    const float Weight,
+    const RePiTexelDecode& Decode,
+    float* Sum)
+{
+    const int32_t Width = Level.GetWidth();
+
+    const float w00 = (1.f - dx) * (1.f - dy) * Weight;
+    const float w10 = dx * (1.f - dy) * Weight;
+    const float w01 = (1.f - dx) * dy * Weight;
+    const float w11 = dx * dy * Weight;
+
+#if defined(REPI_SIMD_SSE41)
+    if (Level.GetBytesPerPixel() == 4 && !Level.IsBlockCompressed())
+    {
+        const uint32_t* Texels = reinterpret_cast<const uint32_t*>(Level.GetPixels());
+        const __m128i Zero = _mm_setzero_si128();
+
+        // The four corners land in one register, one texel per lane
+#if defined(REPI_SIMD_AVX2)
+        const __m128i Indices = _mm_setr_epi32(y0 * Width + x0, y0 * Width + x1, y1 * Width + x0, y1 * Width + x1);
+        const __m128i Quad = _mm_i32gather_epi32(reinterpret_cast<const int32_t*>(Texels), Indices, 4);
+#else
+        const __m128i Quad = _mm_setr_epi32(Texels[y0 * Width + x0], Texels[y0 * Width + x1], Texels[y1 * Width + x0], Texels[y1 * Width + x1]);
+#endif
+        const __m128i Lo = _mm_unpacklo_epi8(Quad, Zero);
+        const __m128i Hi = _mm_unpackhi_epi8(Quad, Zero);
+
+        __m128 Result = _mm_loadu_ps(Sum);
+        Result = _mm_add_ps(Result, _mm_mul_ps(DecodeTexel4(_mm_unpacklo_epi16(Lo, Zero), Decode), _mm_set1_ps(w00)));
+        Result = _mm_add_ps(Result, _mm_mul_ps(DecodeTexel4(_mm_unpackhi_epi16(Lo, Zero), Decode), _mm_set1_ps(w10)));
+        Result = _mm_add_ps(Result, _mm_mul_ps(DecodeTexel4(_mm_unpacklo_epi16(Hi, Zero), Decode), _mm_set1_ps(w01)));
+        Result = _mm_add_ps(Result, _mm_mul_ps(DecodeTexel4(_mm_unpackhi_epi16(Hi, Zero), Decode), _mm_set1_ps(w11)));
+        _mm_storeu_ps(Sum, Result);
+
+        return;
+    }
+#endif
+
+    AccumulateTexel(Level, x0, y0, w00, Decode, Sum);
+    AccumulateTexel(Level, x1, y0, w10, Decode, Sum);
+    AccumulateTexel(Level, x0, y1, w01, Decode, Sum);
+    AccumulateTexel(Level, x1, y1, w11, Decode, Sum);
+}
+
+uint32_t RePiTexture::GetFormatBits(
     const RePiTextureFormat Format)
 {
-    uint32_t BitsSize = 0;
     switch (Format)
     {
     case eR8G8B8A8_UNORM:
-        BitsSize = 32;
-        break;
+    case eR8G8B8A8_UNORM_SRGB:
+        return 32;
     case eR32_FLOAT:
-        BitsSize = 32;
-        break;
+        return 32;
     default:
-        BitsSize = 0;
-        break;
+        return 0;
     }
-    mImage.Create(Size, BitsSize);
+}
+
+void RePiTexture::Create(
+    const RePiInt2& Size,
+    const RePiTextureFormat Format)
+{
+    mImage.Create(Size, GetFormatBits(Format));
+    mImage.SetSRGB(Format == eR8G8B8A8_UNORM_SRGB);
+    mMips.clear();
+}
+
+void RePiTexture::SetSRGB(
+    const bool SRGB)
+{
+    mImage.SetSRGB(SRGB);
+    for (auto& Mip : mMips)
+    {
+        Mip.SetSRGB(SRGB);
+    }
+}
+
+bool RePiTexture::Compress()
+{
+#if defined(REPI_MEASURE_TEXTURE_COMPRESSION)
+    const RePiImage Source(mImage);
+#endif
+
+    bool Result = mImage.Compress();
+
+#if defined(REPI_MEASURE_TEXTURE_COMPRESSION)
+    RePiLog(RePiLogLevel::eINFO, "Texture compressed at " + std::to_string(RePiImage::ComputePSNR(Source, mImage)) + " dB PSNR");
+#endif
+
+    for (auto& Mip : mMips)
+    {
+        Result = Mip.Compress() && Result;
+    }
+
+    return Result;
+}
+
+void RePiTexture::GenerateMips()
+{
+    mMips.clear();
+
+    int32_t Width = mImage.GetWidth();
+    int32_t Height = mImage.GetHeight();
+    if (Width <= 0 || Height <= 0)
+    {
+        return;
+    }
+
+    // sRGB levels are averaged in linear space, otherwise every level comes out darker
+    const bool SRGB = mImage.IsSRGB();
+    const RePiTexelDecode& Decode = SRGB ? g_DecodeSRGB : g_DecodeUnorm;
+
+    // Reserve up front, each level reads the previous one by reference
+    mMips.reserve(static_cast<size_t>(std::bit_width(static_cast<uint32_t>(RePiMath::max(Width, Height)))));
+
+    while (Width > 1 || Height > 1)
+    {
+        const RePiImage& Src = mMips.empty() ? mImage : mMips.back();
+        const int32_t SrcWidth = Width;
+        const int32_t SrcHeight = Height;
+
+        Width = RePiMath::max(1, Width >> 1);
+        Height = RePiMath::max(1, Height >> 1);
+
+        RePiImage Mip;
+        Mip.Create(RePiInt2(Width, Height), 32);
+        Mip.SetSRGB(SRGB);
+
+#pragma omp parallel for
+        for (int32_t y = 0; y < Height; ++y)
+        {
+            const int32_t sy0 = RePiMath::min(y * 2, SrcHeight - 1);
+            const int32_t sy1 = RePiMath::min(y * 2 + 1, SrcHeight - 1);
+
+            for (int32_t x = 0; x < Width; ++x)
+            {
+                const int32_t sx0 = RePiMath::min(x * 2, SrcWidth - 1);
+                const int32_t sx1 = RePiMath::min(x * 2 + 1, SrcWidth - 1);
+
+                float Sum[4] = { 0.f, 0.f, 0.f, 0.f };
+                AccumulateTexel(Src, sx0, sy0, 0.25f, Decode, Sum);
+                AccumulateTexel(Src, sx1, sy0, 0.25f, Decode, Sum);
+                AccumulateTexel(Src, sx0, sy1, 0.25f, Decode, Sum);
+                AccumulateTexel(Src, sx1, sy1, 0.25f, Decode, Sum);
+
+                RePiColor Color = RePiColor::Black;
+                Color.b = SRGB ? EncodeSRGB(Sum[0]) : EncodeUnorm(Sum[0]);
+                Color.g = SRGB ? EncodeSRGB(Sum[1]) : EncodeUnorm(Sum[1]);
+                Color.r = SRGB ? EncodeSRGB(Sum[2]) : EncodeUnorm(Sum[2]);
+                Color.a = EncodeUnorm(Sum[3]);
+
+                Mip.SetPixel(Color, RePiInt2(x, y));
+            }
+        }
+
+        mMips.push_back(std::move(Mip));
+    }
+}
+
+// Row in the sampler tables, modes without a specialization sample as clamp
+static const uint32_t GetAddressModeIndex(
+    const RePiTextureAdressMode AddressMode)
+{
+    switch (AddressMode)
+    {
+    case RePiTextureAdressMode::eWRAP:
+        return 0;
+    case RePiTextureAdressMode::eMIRROR:
+        return 1;
+    case RePiTextureAdressMode::eMIRROR_ONCE:
+        return 2;
+    case RePiTextureAdressMode::eCLAMP:
+    default:
+        return 3;
+    }
+}
+
+static const uint32_t GetSampleFilterIndex(
+    const RePiSampleFilter SampleFilter)
+{
+    return RePiMath::min(static_cast<uint32_t>(SampleFilter), static_cast<uint32_t>(RePiSampleFilter::eFILTER_ANISOTROPIC));
 }
 
 RePiLinearColor RePiTexture::SampleColor(
     const RePiFloat2& uv,
     const RePiTextureAdressMode AddressMode,
-    const RePiSampleFilter SampleFilter)
+    const RePiSampleFilter SampleFilter,
+    const RePiFloat2& Ddx,
+    const RePiFloat2& Ddy,
+    const uint32_t MaxAnisotropy)
+{
+    return ResolveSampleFunction(AddressMode, SampleFilter, mImage.IsSRGB())(*this, uv, Ddx, Ddy, MaxAnisotropy);
+}
+
+RePiSampleFunction RePiTexture::ResolveSampleFunction(
+    const RePiTextureAdressMode AddressMode,
+    const RePiSampleFilter SampleFilter,
+    const bool SRGB)
 {
-    return RePiLinearColor(UnpackFloat(SampleData(uv, AddressMode, SampleFilter)));
+    using Mode = RePiTextureAdressMode;
+    using Filter = RePiSampleFilter;
+
+    static const RePiSampleFunction Functions[4][3][2] =
+    {
+        {
+            { &SampleSpecialized<Mode::eWRAP, Filter::eFILTER_POINT, false>, &SampleSpecialized<Mode::eWRAP, Filter::eFILTER_POINT, true> },
+            { &SampleSpecialized<Mode::eWRAP, Filter::eFILTER_LINEAR, false>, &SampleSpecialized<Mode::eWRAP, Filter::eFILTER_LINEAR, true> },
+            { &SampleSpecialized<Mode::eWRAP, Filter::eFILTER_ANISOTROPIC, false>, &SampleSpecialized<Mode::eWRAP, Filter::eFILTER_ANISOTROPIC, true> }
+        },
+        {
+            { &SampleSpecialized<Mode::eMIRROR, Filter::eFILTER_POINT, false>, &SampleSpecialized<Mode::eMIRROR, Filter::eFILTER_POINT, true> },
+            { &SampleSpecialized<Mode::eMIRROR, Filter::eFILTER_LINEAR, false>, &SampleSpecialized<Mode::eMIRROR, Filter::eFILTER_LINEAR, true> },
+            { &SampleSpecialized<Mode::eMIRROR, Filter::eFILTER_ANISOTROPIC, false>, &SampleSpecialized<Mode::eMIRROR, Filter::eFILTER_ANISOTROPIC, true> }
+        },
+        {
+            { &SampleSpecialized<Mode::eMIRROR_ONCE, Filter::eFILTER_POINT, false>, &SampleSpecialized<Mode::eMIRROR_ONCE, Filter::eFILTER_POINT, true> },
+            { &SampleSpecialized<Mode::eMIRROR_ONCE, Filter::eFILTER_LINEAR, false>, &SampleSpecialized<Mode::eMIRROR_ONCE, Filter::eFILTER_LINEAR, true> },
+            { &SampleSpecialized<Mode::eMIRROR_ONCE, Filter::eFILTER_ANISOTROPIC, false>, &SampleSpecialized<Mode::eMIRROR_ONCE, Filter::eFILTER_ANISOTROPIC, true> }
+        },
+        {
+            { &SampleSpecialized<Mode::eCLAMP, Filter::eFILTER_POINT, false>, &SampleSpecialized<Mode::eCLAMP, Filter::eFILTER_POINT, true> },
+            { &SampleSpecialized<Mode::eCLAMP, Filter::eFILTER_LINEAR, false>, &SampleSpecialized<Mode::eCLAMP, Filter::eFILTER_LINEAR, true> },
+            { &SampleSpecialized<Mode::eCLAMP, Filter::eFILTER_ANISOTROPIC, false>, &SampleSpecialized<Mode::eCLAMP, Filter::eFILTER_ANISOTROPIC, true> }
+        }
+    };
+
+    return Functions[GetAddressModeIndex(AddressMode)][GetSampleFilterIndex(SampleFilter)][SRGB ? 1 : 0];
 }
 
 float RePiTexture::SampleData(
     const RePiFloat2& uv,
+    const RePiTextureAdressMode AddressMode,
+    const RePiSampleFilter SampleFilter,
+    const RePiFloat2& Ddx,
+    const RePiFloat2& Ddy,
+    const uint32_t MaxAnisotropy)
+{
+    float Result[4] = { 0.f, 0.f, 0.f, 0.f };
+    if (nullptr != mImage.GetPixels())
+    {
+        (this->*GetSampleTexels(AddressMode, SampleFilter))(uv, Ddx, Ddy, MaxAnisotropy, g_DecodeRaw, Result);
+    }
+
+    RePiColor Color = RePiColor::Black;
+    Color.b = static_cast<uint8_t>(RePiMath::min(Result[0] + 0.5f, 255.f));
+    Color.g = static_cast<uint8_t>(RePiMath::min(Result[1] + 0.5f, 255.f));
+    Color.r = static_cast<uint8_t>(RePiMath::min(Result[2] + 0.5f, 255.f));
+    Color.a = static_cast<uint8_t>(RePiMath::min(Result[3] + 0.5f, 255.f));
+
+    return PackFloat(Color);
+}
+
+RePiTexture::SampleTexelsFunction RePiTexture::GetSampleTexels(
     const RePiTextureAdressMode AddressMode,
     const RePiSampleFilter SampleFilter)
 {
-    RePiFloat2 UV = uv;
+    using Mode = RePiTextureAdressMode;
+    using Filter = RePiSampleFilter;
 
-    switch (SampleFilter)
-    {
-    case RePiSampleFilter::eFILTER_POINT:
+    static const SampleTexelsFunction Functions[4][3] =
     {
-        AjdustTextureAddress(UV, AddressMode);
-        int32_t x = int32_t(UV.x * (mImage.GetWidth() - 1));
-        int32_t y = int32_t(UV.y * (mImage.GetHeight() - 1));
+        { &RePiTexture::SampleAddressed<Mode::eWRAP, Filter::eFILTER_POINT>, &RePiTexture::SampleAddressed<Mode::eWRAP, Filter::eFILTER_LINEAR>, &RePiTexture::SampleAddressed<Mode::eWRAP, Filter::eFILTER_ANISOTROPIC> },
+        { &RePiTexture::SampleAddressed<Mode::eMIRROR, Filter::eFILTER_POINT>, &RePiTexture::SampleAddressed<Mode::eMIRROR, Filter::eFILTER_LINEAR>, &RePiTexture::SampleAddressed<Mode::eMIRROR, Filter::eFILTER_ANISOTROPIC> },
+        { &RePiTexture::SampleAddressed<Mode::eMIRROR_ONCE, Filter::eFILTER_POINT>, &RePiTexture::SampleAddressed<Mode::eMIRROR_ONCE, Filter::eFILTER_LINEAR>, &RePiTexture::SampleAddressed<Mode::eMIRROR_ONCE, Filter::eFILTER_ANISOTROPIC> },
+        { &RePiTexture::SampleAddressed<Mode::eCLAMP, Filter::eFILTER_POINT>, &RePiTexture::SampleAddressed<Mode::eCLAMP, Filter::eFILTER_LINEAR>, &RePiTexture::SampleAddressed<Mode::eCLAMP, Filter::eFILTER_ANISOTROPIC> }
+    };
 
-        return PackFloat(mImage.GetPixel(RePiInt2(x, y)));
-    }
-    case RePiSampleFilter::eFILTER_LINEAR:
+    return Functions[GetAddressModeIndex(AddressMode)][GetSampleFilterIndex(SampleFilter)];
+}
+
+template<RePiTextureAdressMode AddressMode, RePiSampleFilter SampleFilter, bool SRGB>
+RePiLinearColor RePiTexture::SampleSpecialized(
+    RePiTexture& Texture,
+    const RePiFloat2& uv,
+    const RePiFloat2& Ddx,
+    const RePiFloat2& Ddy,
+    const uint32_t MaxAnisotropy)
+{
+    float Result[4] = { 0.f, 0.f, 0.f, 0.f };
+    if (nullptr != Texture.mImage.GetPixels())
     {
-        AjdustTextureAddress(UV, AddressMode);
-        float x = UV.x * (mImage.GetWidth() - 1);
-        float y = UV.y * (mImage.GetHeight() - 1);
+        Texture.SampleAddressed<AddressMode, SampleFilter>(uv, Ddx, Ddy, MaxAnisotropy, SRGB ? g_DecodeSRGB : g_DecodeUnorm, Result);
+    }
 
-        int32_t x0 = int32_t(x);
-        int32_t y0 = int32_t(y);
-        int32_t x1 = RePiMath::min(x0 + 1, mImage.GetWidth() - 1);
-        int32_t y1 = RePiMath::min(y0 + 1, mImage.GetHeight() - 1);
+    // Byte 0 is blue and byte 2 is red, same as GetPixel
+    return RePiLinearColor(Result[2], Result[1], Result[0], Result[3]);
+}
 
-        float dx = x - x0;
-        float dy = y - y0;
+template<RePiTextureAdressMode AddressMode, RePiSampleFilter SampleFilter>
+void RePiTexture::SampleAddressed(
+    const RePiFloat2& uv,
+    const RePiFloat2& Ddx,
+    const RePiFloat2& Ddy,
+    const uint32_t MaxAnisotropy,
+    const RePiTexelDecode& Decode,
+    float* Result)
+{
+    const int32_t Width = mImage.GetWidth();
+    const int32_t Height = mImage.GetHeight();
 
-        RePiLinearColor c00(mImage.GetPixel(RePiInt2(x0, y0)));
-        RePiLinearColor c10(mImage.GetPixel(RePiInt2(x1, y0)));
-        RePiLinearColor c01(mImage.GetPixel(RePiInt2(x0, y1)));
-        RePiLinearColor c11(mImage.GetPixel(RePiInt2(x1, y1)));
+    if constexpr (RePiSampleFilter::eFILTER_POINT == SampleFilter)
+    {
+        int32_t x = AddressTexel<AddressMode>(int32_t(std::floor(uv.x * Width)), Width, GetWrapMask(Width));
+        int32_t y = AddressTexel<AddressMode>(int32_t(std::floor(uv.y * Height)), Height, GetWrapMask(Height));
+
+        AccumulateTexel(mImage, x, y, 1.f, Decode, Result);
+    }
+    else if constexpr (RePiSampleFilter::eFILTER_LINEAR == SampleFilter)
+    {
+        // Texel centers sit at half integers
+        const float Coords[2] = { uv.x * Width - 0.5f, uv.y * Height - 0.5f };
 
-        RePiLinearColor c0 = c00 * (1.f - dx) + c10 * dx;
-        RePiLinearColor c1 = c01 * (1.f - dx) + c11 * dx;
+        int32_t x0, x1, y0, y1;
+        float dx, dy;
+        AddressTexels<AddressMode>(&Coords[0], 1, Width, &x0, &x1, &dx);
+        AddressTexels<AddressMode>(&Coords[1], 1, Height, &y0, &y1, &dy);
 
-        return PackFloat((c0 * (1.f - dy) + c1 * dy).toColor(true));
+        AccumulateBilinear(mImage, x0, x1, y0, y1, dx, dy, 1.f, Decode, Result);
     }
-    default:
+    else
+    {
+        SampleAnisotropic<AddressMode>(uv, Ddx, Ddy, MaxAnisotropy, Decode, Result);
+    }
+}
+
+template<RePiTextureAdressMode AddressMode>
+void RePiTexture::SampleAnisotropic(
+    const RePiFloat2& uv,
+    const RePiFloat2& Ddx,
+    const RePiFloat2& Ddy,
+    const uint32_t MaxAnisotropy,
+    const RePiTexelDecode& Decode,
+    float* Result)
+{
+    const float Width = float(mImage.GetWidth());
+    const float Height = float(mImage.GetHeight());
+
+    // Footprint of the pixel in base level texels along each screen axis
+    const float LengthX = std::sqrt(Ddx.x * Ddx.x * Width * Width + Ddx.y * Ddx.y * Height * Height);
+    const float LengthY = std::sqrt(Ddy.x * Ddy.x * Width * Width + Ddy.y * Ddy.y * Height * Height);
+    const float MajorLength = RePiMath::max(LengthX, LengthY);
+    const float MinorLength = RePiMath::min(LengthX, LengthY);
+    const RePiFloat2& MajorAxis = LengthX > LengthY ? Ddx : Ddy;
+
+    const uint32_t MaxRatio = RePiMath::min(RePiMath::max(MaxAnisotropy, 1u), MaxAnisotropyProbes);
+    const float Ratio = RePiMath::min(MajorLength / RePiMath::max(MinorLength, 1e-6f), float(MaxRatio));
+    const uint32_t Probes = RePiMath::min(RePiMath::max(1u, static_cast<uint32_t>(std::ceil(Ratio))), MaxRatio);
+
+    // The level is picked from the footprint each probe covers, not the whole ellipse
+    const float Lod = MajorLength > 0.f ? std::log2(MajorLength / float(Probes)) : 0.f;
+    const uint32_t Level = static_cast<uint32_t>(RePiMath::min(RePiMath::max(Lod + 0.5f, 0.f), float(mMips.size())));
+    const RePiImage& Image = Level == 0 ? mImage : mMips[Level - 1];
+
+    const float LevelWidth = float(Image.GetWidth());
+    const float LevelHeight = float(Image.GetHeight());
+    const float Weight = 1.f / float(Probes);
+
+    float ProbeX[MaxAnisotropyProbes];
+    float ProbeY[MaxAnisotropyProbes];
+    for (uint32_t i = 0; i < Probes; ++i)
     {
-        return 0.f;
+        const float Offset = (float(i) + 0.5f) * Weight - 0.5f;
+
+        ProbeX[i] = (uv.x + MajorAxis.x * Offset) * LevelWidth - 0.5f;
+        ProbeY[i] = (uv.y + MajorAxis.y * Offset) * LevelHeight - 0.5f;
     }
+
+    // Every probe is addressed in one batch per axis
+    int32_t X0[MaxAnisotropyProbes], X1[MaxAnisotropyProbes], Y0[MaxAnisotropyProbes], Y1[MaxAnisotropyProbes];
+    float Fx[MaxAnisotropyProbes], Fy[MaxAnisotropyProbes];
+    AddressTexels<AddressMode>(ProbeX, Probes, Image.GetWidth(), X0, X1, Fx);
+    AddressTexels<AddressMode>(ProbeY, Probes, Image.GetHeight(), Y0, Y1, Fy);
+
+    for (uint32_t i = 0; i < Probes; ++i)
+    {
+        AccumulateBilinear(Image, X0[i], X1[i], Y0[i], Y1[i], Fx[i], Fy[i], Weight, Decode, Result);
     }
+}
 
-    return 0.f;
+RePiLinearColor RePiTexture::LoadColor(
+    const RePiInt2 xy) const
+{
+    const RePiTexelDecode& Decode = mImage.IsSRGB() ? g_DecodeSRGB : g_DecodeUnorm;
+    const RePiColor Color = mImage.GetPixel(xy);
+
+    return RePiLinearColor(Decode.Table[2][Color.r], Decode.Table[1][Color.g], Decode.Table[0][Color.b], Decode.Table[3][Color.a]);
+}
+
+float RePiTexture::LoadData(
+    const RePiInt2 xy) const
+{
+    return PackFloat(mImage.GetPixel(xy));
 }
 
 void RePiTexture::WriteColor(
     const RePiInt2 xy,
     const RePiLinearColor& Color)
 {
-    mImage.SetPixel(Color.toColor(true), xy);
+    const bool SRGB = mImage.IsSRGB();
+
+    RePiColor Encoded = RePiColor::Black;
+    Encoded.r = SRGB ? EncodeSRGB(Color.r) : EncodeUnorm(Color.r);
+    Encoded.g = SRGB ? EncodeSRGB(Color.g) : EncodeUnorm(Color.g);
+    Encoded.b = SRGB ? EncodeSRGB(Color.b) : EncodeUnorm(Color.b);
+    Encoded.a = EncodeUnorm(Color.a);
+
+    mImage.SetPixel(Encoded, xy);
 }
 
 void RePiTexture::WriteData(
@@ -115,66 +772,32 @@ void RePiTexture::Save(
     mImage.Encode(Filename);
 }
 
-void* RePiTexture::GetBufferData()
+void RePiTexture::SaveBaked(
+    const std::string& Filename)
 {
-    return mImage.GetData();
+    mImage.EncodeBaked(Filename);
 }
 
-void RePiTexture::AjdustTextureAddress(
-    RePiFloat2& uv,
-    const RePiTextureAdressMode AddressMode)
+void RePiTexture::SaveAsync(
+    const std::string& Filename)
 {
-    auto& u = uv.x;
-    auto& v = uv.y;
-
-    switch (AddressMode)
-    {
-    case RePiTextureAdressMode::eWRAP:
-        u = std::fmodf(u, 1.f);
-        v = std::fmodf(v, 1.f);
-        break;
-
-    case RePiTextureAdressMode::eMIRROR:
-        u = std::fmodf(u, 2.f);
-        v = std::fmodf(v, 2.f);
-
-        if (u < 0.f) u = 2.f + u;
-        if (v < 0.f) v = 2.f + v;
-        if (u > 1.f) u = 2.f - u;
-        if (v > 1.f) v = 2.f - v;
-        break;
-
-    case RePiTextureAdressMode::eMIRROR_ONCE:
-        if ((u > -1.f && u < 0.f) || (u > 1.f && u < 2.f))
-        {
-            u = 1.f - std::fmodf(u, 1.f);
-        }
-        else
-        {
-            u = u < 0.f ? 0.f : u;
-            u = u > 1.f ? 1.f : u;
-        }
+    RePiImageWriter::Instance().Save(RePiImage(mImage), Filename);
+}
 
-        if ((v > -1.f && v < 0.f) || (v > 1.f && v < 2.f))
-        {
-            v = 1.f - std::fmodf(v, 1.f);
-        }
-        else
-        {
-            v = v < 0.f ? 0.f : v;
-            v = v > 1.f ? 1.f : v;
-        }
-        break;
+void RePiTexture::SaveSequence(
+    const std::string& Prefix)
+{
+    RePiImageWriter::Instance().SaveSequence(RePiImage(mImage), Prefix);
+}
 
-    case RePiTextureAdressMode::eCLAMP:
-    default:
-        u = u < 0.f ? 0.f : u;
-        u = u > 1.f ? 1.f : u;
+void RePiTexture::StreamFrame()
+{
+    RePiImageWriter::Instance().WriteStreamFrame(RePiImage(mImage));
+}
 
-        v = v < 0.f ? 0.f : v;
-        v = v > 1.f ? 1.f : v;
-        break;
-    }
+void* RePiTexture::GetBufferData()
+{
+    return mImage.GetData();
 }
 
 float RePiTexture::PackFloat(
@@ -3,6 +3,17 @@
 #include "RePiBase.h"
 #include "RePiImage.h"
 
+struct RePiTexelDecode;
+class RePiTexture;
+
+// Sampler entry point with address mode, filter and color space baked in
+using RePiSampleFunction = RePiLinearColor(*)(
+    RePiTexture& Texture,
+    const RePiFloat2& uv,
+    const RePiFloat2& Ddx,
+    const RePiFloat2& Ddy,
+    const uint32_t MaxAnisotropy);
+
 class RePiTexture
 {
 public:
@@ -13,27 +24,78 @@ public:
         const RePiInt2& Size = RePiInt2::ZERO,
         const RePiTextureFormat Format = RePiTextureFormat::eR8G8B8A8_UNORM);
 
+    static uint32_t GetFormatBits(
+        const RePiTextureFormat Format = RePiTextureFormat::eR8G8B8A8_UNORM);
+
     void CreateFromImage(
         const RePiImage& Image)
     {
         mImage = Image;
+        mMips.clear();
     }
 
+    // Loaded pixels stay mapped and read-only unless Writable is set
     bool CreateFromFile(
-        const std::string& Filename = "")
+        const std::string& Filename = "",
+        const bool Writable = false)
+    {
+        mMips.clear();
+
+        if (!mImage.Decode(Filename))
+        {
+            return false;
+        }
+
+        return !Writable || mImage.MakeWritable();
+    }
+
+    bool Compress();
+
+    // Marks the texture as gamma encoded, sampling decodes it and writes encode to it
+    void SetSRGB(
+        const bool SRGB = true);
+
+    bool IsSRGB() const
+    {
+        return mImage.IsSRGB();
+    }
+
+    // Builds the box filtered mip chain down to 1x1, used by anisotropic sampling
+    void GenerateMips();
+
+    uint32_t GetMipCount() const
     {
-        return mImage.Decode(Filename);
+        return static_cast<uint32_t>(mMips.size()) + 1;
     }
 
     RePiLinearColor SampleColor(
         const RePiFloat2& uv = RePiFloat2::ZERO,
         const RePiTextureAdressMode AddressMode = RePiTextureAdressMode::eCLAMP,
-        const RePiSampleFilter SampleFilter = RePiSampleFilter::eFILTER_POINT);
+        const RePiSampleFilter SampleFilter = RePiSampleFilter::eFILTER_POINT,
+        const RePiFloat2& Ddx = RePiFloat2::ZERO,
+        const RePiFloat2& Ddy = RePiFloat2::ZERO,
+        const uint32_t MaxAnisotropy = 16);
+
+    // Picks the specialized sampler once so per pixel calls skip the mode and filter switches
+    static RePiSampleFunction ResolveSampleFunction(
+        const RePiTextureAdressMode AddressMode = RePiTextureAdressMode::eCLAMP,
+        const RePiSampleFilter SampleFilter = RePiSampleFilter::eFILTER_POINT,
+        const bool SRGB = false);
 
     float SampleData(
         const RePiFloat2& uv = RePiFloat2::ZERO,
         const RePiTextureAdressMode AddressMode = RePiTextureAdressMode::eCLAMP,
-        const RePiSampleFilter SampleFilter = RePiSampleFilter::eFILTER_POINT);
+        const RePiSampleFilter SampleFilter = RePiSampleFilter::eFILTER_POINT,
+        const RePiFloat2& Ddx = RePiFloat2::ZERO,
+        const RePiFloat2& Ddy = RePiFloat2::ZERO,
+        const uint32_t MaxAnisotropy = 16);
+
+    // Unfiltered reads of a single texel, counterparts of WriteColor and WriteData
+    RePiLinearColor LoadColor(
+        const RePiInt2 xy = RePiInt2::ZERO) const;
+
+    float LoadData(
+        const RePiInt2 xy = RePiInt2::ZERO) const;
 
     void WriteColor(
         const RePiInt2 xy = RePiInt2::ZERO,
@@ -54,12 +116,60 @@ public:
     void Save(
         const std::string& Filename = "");
 
+    void SaveBaked(
+        const std::string& Filename = "");
+
+    // Snapshots the texture and encodes it on the image writer thread
+    void SaveAsync(
+        const std::string& Filename = "");
+
+    void SaveSequence(
+        const std::string& Prefix = "");
+
+    void StreamFrame();
+
     void* GetBufferData();
 
 private:
-    void AjdustTextureAddress(
-        RePiFloat2& uv,
-        const RePiTextureAdressMode AddressMode = RePiTextureAdressMode::eCLAMP);
+    using SampleTexelsFunction = void (RePiTexture::*)(
+        const RePiFloat2& uv,
+        const RePiFloat2& Ddx,
+        const RePiFloat2& Ddy,
+        const uint32_t MaxAnisotropy,
+        const RePiTexelDecode& Decode,
+        float* Result);
+
+    // Filtered texel bytes run through Decode, Result stays in the image's byte order
+    static SampleTexelsFunction GetSampleTexels(
+        const RePiTextureAdressMode AddressMode,
+        const RePiSampleFilter SampleFilter);
+
+    template<RePiTextureAdressMode AddressMode, RePiSampleFilter SampleFilter, bool SRGB>
+    static RePiLinearColor SampleSpecialized(
+        RePiTexture& Texture,
+        const RePiFloat2& uv,
+        const RePiFloat2& Ddx,
+        const RePiFloat2& Ddy,
+        const uint32_t MaxAnisotropy);
+
+    // Sampling body specialized per address mode and filter
+    template<RePiTextureAdressMode AddressMode, RePiSampleFilter SampleFilter>
+    void SampleAddressed(
+        const RePiFloat2& uv,
+        const RePiFloat2& Ddx,
+        const RePiFloat2& Ddy,
+        const uint32_t MaxAnisotropy,
+        const RePiTexelDecode& Decode,
+        float* Result);
+
+    template<RePiTextureAdressMode AddressMode>
+    void SampleAnisotropic(
+        const RePiFloat2& uv,
+        const RePiFloat2& Ddx,
+        const RePiFloat2& Ddy,
+        const uint32_t MaxAnisotropy,
+        const RePiTexelDecode& Decode,
+        float* Result);
 
     float PackFloat(
         const RePiColor& Color = RePiColor::Black) const;
@@ -69,4 +179,7 @@ private:
 
 protected:
     RePiImage mImage;
+
+    // Levels 1..n, level 0 is mImage
+    std::vector<RePiImage> mMips;
 };
@@ -0,0 +1,119 @@
+#include "RePiTexturePool.h"
+
+RePiTexturePool::RePiTexturePool() :
+    mAllocatedBytes(0),
+    mPeakBytes(0)
+{
+}
+
+std::shared_ptr<RePiTexture> RePiTexturePool::Acquire(
+    const RePiInt2& Size,
+    const RePiTextureFormat Format)
+{
+    const uint32_t BitsPerPixel = RePiTexture::GetFormatBits(Format);
+    if (0 == BitsPerPixel || Size.x <= 0 || Size.y <= 0)
+    {
+        RePiLog(RePiLogLevel::eWARNING, "Texture pool can't allocate the requested size or format");
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> Lock(mMutex);
+
+    auto& Entries = mEntries[GetKey(Size, Format)];
+
+    std::shared_ptr<RePiTexture> Texture;
+    for (auto& Entry : Entries)
+    {
+        if (1 == Entry.Texture.use_count())
+        {
+            Texture = Entry.Texture;
+            break;
+        }
+    }
+
+    if (nullptr == Texture)
+    {
+        Texture = std::make_shared<RePiTexture>();
+
+        const size_t Bytes = static_cast<size_t>(Size.x) * Size.y * (BitsPerPixel >> 3);
+        Entries.push_back({ Texture, Bytes });
+        mAllocatedBytes += Bytes;
+    }
+
+    // Same size and format, so the pixel buffer keeps its allocation
+    Texture->Create(Size, Format);
+
+    mPeakBytes = RePiMath::max(mPeakBytes, CountLiveBytes());
+
+    return Texture;
+}
+
+void RePiTexturePool::Trim()
+{
+    std::lock_guard<std::mutex> Lock(mMutex);
+
+    for (auto It = mEntries.begin(); It != mEntries.end();)
+    {
+        auto& Entries = It->second;
+        for (size_t i = 0; i < Entries.size();)
+        {
+            if (1 == Entries[i].Texture.use_count())
+            {
+                mAllocatedBytes -= Entries[i].Bytes;
+                Entries[i] = std::move(Entries.back());
+                Entries.pop_back();
+            }
+            else
+            {
+                ++i;
+            }
+        }
+
+        It = Entries.empty() ? mEntries.erase(It) : std::next(It);
+    }
+}
+
+size_t RePiTexturePool::GetLiveBytes()
+{
+    std::lock_guard<std::mutex> Lock(mMutex);
+
+    return CountLiveBytes();
+}
+
+size_t RePiTexturePool::GetPeakBytes()
+{
+    std::lock_guard<std::mutex> Lock(mMutex);
+
+    return mPeakBytes;
+}
+
+size_t RePiTexturePool::GetAllocatedBytes()
+{
+    std::lock_guard<std::mutex> Lock(mMutex);
+
+    return mAllocatedBytes;
+}
+
+uint64_t RePiTexturePool::GetKey(
+    const RePiInt2& Size,
+    const RePiTextureFormat Format)
+{
+    return (static_cast<uint64_t>(Format) << 48) | (static_cast<uint64_t>(Size.x) << 24) | static_cast<uint64_t>(Size.y);
+}
+
+size_t RePiTexturePool::CountLiveBytes() const
+{
+    size_t Bytes = 0;
+    for (const auto& Entries : mEntries)
+    {
+        for (const auto& Entry : Entries.second)
+        {
+            if (Entry.Texture.use_count() > 1)
+            {
+                Bytes += Entry.Bytes;
+            }
+        }
+    }
+
+    return Bytes;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "RePiBase.h"
+#include "RePiModule.h"
+#include "RePiTexture.h"
+
+#include <mutex>
+
+class RePiTexturePool : public RePiModule<RePiTexturePool, std::function<void()>>
+{
+public:
+    RePiTexturePool();
+
+    virtual ~RePiTexturePool() = default;
+
+    // Hands out an idle texture of the same size and format or allocates one, contents are undefined
+    std::shared_ptr<RePiTexture> Acquire(
+        const RePiInt2& Size = RePiInt2::ZERO,
+        const RePiTextureFormat Format = RePiTextureFormat::eR8G8B8A8_UNORM);
+
+    // Frees the textures nobody outside the pool holds anymore
+    void Trim();
+
+    // Bytes held by textures currently handed out
+    size_t GetLiveBytes();
+
+    size_t GetPeakBytes();
+
+    // Bytes owned by the pool, idle textures included
+    size_t GetAllocatedBytes();
+
+private:
+    struct RePiPoolEntry
+    {
+        std::shared_ptr<RePiTexture> Texture;
+        size_t Bytes = 0;
+    };
+
+    static uint64_t GetKey(
+        const RePiInt2& Size = RePiInt2::ZERO,
+        const RePiTextureFormat Format = RePiTextureFormat::eUNKNOWN);
+
+    size_t CountLiveBytes() const;
+
+private:
+    std::mutex mMutex;
+
+    // An entry is idle when the pool holds the only reference
+    std::map<uint64_t, std::vector<RePiPoolEntry>> mEntries;
+
+    size_t mAllocatedBytes;
+
+    size_t mPeakBytes;
+};
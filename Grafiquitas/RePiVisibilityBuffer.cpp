@@ -0,0 +1,187 @@
+#include "RePiVisibilityBuffer.h"
+
+#include "RePi3DModel.h"
+#include "RePiMaterial.h"
+#include "RePiTexture.h"
+
+RePiVisibilityBuffer::RePiVisibilityBuffer() :
+    mSize(RePiInt2::ZERO),
+    mShading(MaxDraws, "Visibility buffer")
+{
+}
+
+void RePiVisibilityBuffer::Clear(
+    const RePiInt2& Size)
+{
+    mSize = Size;
+    mTexels.assign(static_cast<size_t>(mSize.x) * mSize.y, EmptyTexel);
+
+    for (auto& Triangles : mTriangles)
+    {
+        Triangles.clear();
+        mSpareTriangles.push_back(std::move(Triangles));
+    }
+    mTriangles.clear();
+    mShading.Clear();
+}
+
+uint32_t RePiVisibilityBuffer::RegisterDraw(
+    const size_t TriangleCount,
+    const std::weak_ptr<RePiMaterial>& Material,
+    const PixelShader& Shader)
+{
+    if (TriangleCount > MaxTriangles)
+    {
+        RePiLog(RePiLogLevel::eWARNING, "Draw has more triangles than the visibility buffer can address, it won't be shaded");
+        return EmptyDraw;
+    }
+
+    const uint32_t DrawID = mShading.RegisterDraw(Material, Shader);
+    if (EmptyDraw == DrawID)
+    {
+        return EmptyDraw;
+    }
+
+    if (mSpareTriangles.empty())
+    {
+        mTriangles.emplace_back();
+    }
+    else
+    {
+        mTriangles.push_back(std::move(mSpareTriangles.back()));
+        mSpareTriangles.pop_back();
+    }
+
+    return DrawID;
+}
+
+void RePiVisibilityBuffer::AdoptTriangles(
+    const uint32_t DrawID,
+    std::vector<RePiTriangle>& TriangleList)
+{
+    if (DrawID >= mTriangles.size())
+    {
+        return;
+    }
+
+    // The draw held an empty spare, the caller gets it back to fill on its next draw
+    mTriangles[DrawID].swap(TriangleList);
+}
+
+void RePiVisibilityBuffer::Shade(
+    RePiTexture& Target,
+    const std::weak_ptr<RasterizerConstantBuffer>& ConstantBuffer,
+    const RePiSampleFilter MaxFilter)
+{
+    if (Target.GetSize() != RePiFloat2(float(mSize.x), float(mSize.y)))
+    {
+        return;
+    }
+
+    mShading.Shade(mSize, MaxFilter, [&](const RePiInt2& Min, const RePiInt2& Max)
+    {
+        RePiTriangleSetup Setup;
+
+        for (int32_t y = Min.y; y < Max.y; ++y)
+        {
+            for (int32_t x = Min.x; x < Max.x; ++x)
+            {
+                const uint32_t ID = static_cast<uint32_t>(mTexels[static_cast<size_t>(y) * mSize.x + x]);
+                const RePiDeferredShading::RePiDeferredDraw* pDraw = mShading.GetDraw(ID >> TriangleBits);
+                if (nullptr == pDraw)
+                {
+                    continue;
+                }
+
+                if (ID != Setup.ID)
+                {
+                    SetupTriangle(Setup, ID);
+                }
+
+                const RePiInt2 xy(x, y);
+                Target.WriteColor(xy, pDraw->Shader(Interpolate(Setup, xy), pDraw->Material, ConstantBuffer));
+            }
+        }
+    });
+}
+
+void RePiVisibilityBuffer::SetupTriangle(
+    RePiTriangleSetup& Setup,
+    const uint32_t ID) const
+{
+    const RePiTriangle& T = mTriangles[ID >> TriangleBits][ID & (MaxTriangles - 1)];
+
+    // Same snapping the rasterizer applies before scan converting
+    const RePiFloat2 Size(float(mSize.x), float(mSize.y));
+    auto ToScreen = [&Size](const RePiFloat4& Clip)
+    {
+        const RePiFloat2 xy = RePiRasterizerStage::NdcToScreen(RePiFloat2(Clip.x, Clip.y), Size);
+        return RePiFloat2(float(int32_t(xy.x)), float(int32_t(xy.y)));
+    };
+
+    const RePiFloat2 P0 = ToScreen(T.v0.Position);
+    const RePiFloat2 E1 = ToScreen(T.v1.Position) - P0;
+    const RePiFloat2 E2 = ToScreen(T.v2.Position) - P0;
+    const float Area = E1.x * E2.y - E1.y * E2.x;
+
+    Setup.ID = ID;
+    Setup.Triangle = &T;
+    Setup.Origin = P0;
+    Setup.Degenerate = 0.f == Area;
+
+    // Aligned once per triangle, like the rasterizer's spans
+    Setup.TangentFrames[0] = T.v0.TangentFrame;
+    Setup.TangentFrames[1] = T.v1.TangentFrame;
+    Setup.TangentFrames[2] = T.v2.TangentFrame;
+    Setup.TangentHandedness = RePiVertex::AlignTangentFrames(Setup.TangentFrames[0], Setup.TangentFrames[1], Setup.TangentFrames[2]);
+    if (!Setup.Degenerate)
+    {
+        // Change of the v1 and v2 barycentric weights per pixel step
+        Setup.DdxWeights = RePiFloat2(E2.y, -E1.y) / Area;
+        Setup.DdyWeights = RePiFloat2(-E2.x, E1.x) / Area;
+    }
+}
+
+RePiVertex RePiVisibilityBuffer::Interpolate(
+    const RePiTriangleSetup& Setup,
+    const RePiInt2& xy) const
+{
+    const RePiTriangle& T = *Setup.Triangle;
+    if (Setup.Degenerate)
+    {
+        RePiVertex V(RePiFloat3(float(xy.x), float(xy.y), T.v0.Position.z), T.v0.TexCoord);
+        V.TangentFrame = Setup.TangentFrames[0];
+        V.TangentHandedness = Setup.TangentHandedness;
+        V.Normal = V.GetFrameNormal();
+        return V;
+    }
+
+    const float dx = float(xy.x) - Setup.Origin.x;
+    const float dy = float(xy.y) - Setup.Origin.y;
+
+    // Snapped edges can leave border pixels just outside, keep them on the triangle
+    float w1 = RePiMath::max(0.f, Setup.DdxWeights.x * dx + Setup.DdyWeights.x * dy);
+    float w2 = RePiMath::max(0.f, Setup.DdxWeights.y * dx + Setup.DdyWeights.y * dy);
+    const float Sum = w1 + w2;
+    if (Sum > 1.f)
+    {
+        w1 /= Sum;
+        w2 /= Sum;
+    }
+
+    const RePiFloat2 dUV1 = T.v1.TexCoord - T.v0.TexCoord;
+    const RePiFloat2 dUV2 = T.v2.TexCoord - T.v0.TexCoord;
+
+    RePiVertex V(RePiFloat3(float(xy.x), float(xy.y), T.v0.Position.z + (T.v1.Position.z - T.v0.Position.z) * w1 + (T.v2.Position.z - T.v0.Position.z) * w2),
+                 T.v0.TexCoord + dUV1 * w1 + dUV2 * w2);
+    const RePiFloat4* Q = Setup.TangentFrames;
+    V.TangentFrame = Q[0] + (Q[1] - Q[0]) * w1 + (Q[2] - Q[0]) * w2;
+    V.TangentHandedness = Setup.TangentHandedness;
+    V.Normal = V.GetFrameNormal();
+
+    // Texcoords are affine in screen space, the derivatives come straight from the edges
+    V.TexCoordDdx = dUV1 * Setup.DdxWeights.x + dUV2 * Setup.DdxWeights.y;
+    V.TexCoordDdy = dUV1 * Setup.DdyWeights.x + dUV2 * Setup.DdyWeights.y;
+
+    return V;
+}
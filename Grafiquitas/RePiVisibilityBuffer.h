@@ -0,0 +1,108 @@
+#pragma once
+
+#include "RePiBase.h"
+#include "RePiDeferredShading.h"
+#include "RePiRasterizerStage.h"
+
+#include <atomic>
+
+struct RePiTriangle;
+class RePiMaterial;
+class RePiTexture;
+
+class RePiVisibilityBuffer
+{
+public:
+    RePiVisibilityBuffer();
+
+    ~RePiVisibilityBuffer() = default;
+
+    // Empties every pixel, the draws' triangle lists are kept as spares for the next frame
+    void Clear(
+        const RePiInt2& Size = RePiInt2::ZERO);
+
+    // Records the material and shader of a draw with TriangleCount triangles, returns its id
+    uint32_t RegisterDraw(
+        const size_t TriangleCount,
+        const std::weak_ptr<RePiMaterial>& Material,
+        const PixelShader& Shader);
+
+    // Swaps the draw's transformed triangles in once it's rasterized, no copy
+    // TriangleList comes back empty, holding a list the buffer released on an earlier Clear
+    void AdoptTriangles(
+        const uint32_t DrawID,
+        std::vector<RePiTriangle>& TriangleList);
+
+    // Depth in the high word and the id in the low one, an atomic min keeps the nearest triangle
+    void Write(
+        const RePiInt2& xy,
+        const float Depth,
+        const uint32_t DrawID,
+        const uint32_t TriangleID)
+    {
+        // Non negative floats order like their bits
+        const uint64_t Packed = (static_cast<uint64_t>(std::bit_cast<uint32_t>(RePiMath::max(Depth, 0.f))) << 32) | (DrawID << TriangleBits) | TriangleID;
+
+        std::atomic_ref<uint64_t> Texel(mTexels[static_cast<size_t>(xy.y) * mSize.x + xy.x]);
+        uint64_t Current = Texel.load(std::memory_order_relaxed);
+        while (Packed < Current && !Texel.compare_exchange_weak(Current, Packed, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    // Interpolates the attributes of each visible pixel from its triangle and runs the draw's shader, tiles are shaded in parallel
+    void Shade(
+        RePiTexture& Target,
+        const std::weak_ptr<RasterizerConstantBuffer>& ConstantBuffer,
+        const RePiSampleFilter MaxFilter = RePiSampleFilter::eFILTER_ANISOTROPIC);
+
+    RePiInt2 GetSize() const
+    {
+        return mSize;
+    }
+
+    static const uint32_t TriangleBits = 22;
+    static const uint32_t MaxTriangles = 1u << TriangleBits;
+    static const uint32_t MaxDraws = (1u << (32 - TriangleBits)) - 1;
+
+    // Also what RegisterDraw returns for a draw the buffer can't address
+    static const uint32_t EmptyDraw = MaxDraws;
+
+    // Infinite depth with the empty draw id, loses every Write
+    static const uint64_t EmptyTexel = (static_cast<uint64_t>(0x7F800000u) << 32) | (static_cast<uint64_t>(EmptyDraw) << TriangleBits);
+
+private:
+    // Screen space edges of one triangle, reused while a tile keeps hitting it
+    struct RePiTriangleSetup
+    {
+        uint32_t ID = UINT32_MAX;
+        const RePiTriangle* Triangle = nullptr;
+        RePiFloat2 Origin;
+        RePiFloat2 DdxWeights;
+        RePiFloat2 DdyWeights;
+        RePiFloat4 TangentFrames[3];
+        float TangentHandedness = 1.f;
+        bool Degenerate = true;
+    };
+
+    void SetupTriangle(
+        RePiTriangleSetup& Setup,
+        const uint32_t ID) const;
+
+    RePiVertex Interpolate(
+        const RePiTriangleSetup& Setup,
+        const RePiInt2& xy) const;
+
+private:
+    RePiInt2 mSize;
+
+    std::vector<uint64_t> mTexels;
+
+    RePiDeferredShading mShading;
+
+    // Indexed by draw id, next to mShading's draw table
+    std::vector<std::vector<RePiTriangle>> mTriangles;
+
+    // Triangle lists released by Clear, swapped back out to the geometry stage so neither side reallocates
+    std::vector<std::vector<RePiTriangle>> mSpareTriangles;
+};